@@ -127,7 +127,9 @@ void MainWindow::on_searchBox_textChanged(const QString &arg1)
         ui->resultsList->setVisible(false);
         return;
     }
-    autocompleteProcess->write((arg1 + "\n").toUtf8());
+    // One session for the search box: the engine keeps its place in the trie
+    // and only steps over the characters that changed since the last line.
+    autocompleteProcess->write(("#1 =" + arg1 + "\n").toUtf8());
 }
 
 void MainWindow::handleAutocompleteOutput()
@@ -0,0 +1,53 @@
+#ifndef CORPUS_STATS_HPP
+#define CORPUS_STATS_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include "json.hpp"
+
+using namespace std;
+
+// Document statistics the index header needs, taken from doc_info.jsonl.
+struct CorpusStats {
+    uint64_t numDocs = 0;
+    uint64_t totalDocLength = 0;
+    int64_t maxDocId = -1;
+};
+
+inline bool compute_corpus_stats(const string& docInfoPath, CorpusStats& stats) {
+    ifstream infile(docInfoPath);
+    static char buffer[1024*1024];
+    infile.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
+    if (!infile.is_open()) {
+        cerr << "Error: Could not open " << docInfoPath << endl;
+        return false;
+    }
+
+    cout << "Computing corpus statistics..." << endl;
+    string line;
+    while (getline(infile, line)) {
+        try {
+            auto j = nlohmann::json::parse(line);
+            int64_t doc_id = j["id"];
+            uint64_t doc_length = j["len"];
+
+            stats.numDocs++;
+            stats.totalDocLength += doc_length;
+            if (doc_id > stats.maxDocId) stats.maxDocId = doc_id;
+
+            if (stats.numDocs % 100000 == 0) {
+                cout << stats.numDocs << " documents scanned.\r" << flush;
+            }
+        } catch (exception& e) {
+            cerr << "Error (corpus stats): " << e.what() << endl;
+            continue;
+        }
+    }
+
+    cout << "\nCorpus: " << stats.numDocs << " docs, total length " << stats.totalDocLength << ", max doc id " << stats.maxDocId << endl;
+    return true;
+}
+
+#endif // CORPUS_STATS_HPP
@@ -0,0 +1,110 @@
+#ifndef DOC_INFO_HPP
+#define DOC_INFO_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+using namespace std;
+
+// Reading doc_info.jsonl without a general JSON parser. Every line is
+//   {"id": 12, "title": "...", "len": 345}
+// written by multiparser.py with Python's ASCII-only json.dumps, so anything
+// outside ASCII arrives as \uXXXX, possibly as a surrogate pair.
+
+inline void append_utf8(string& out, uint32_t code) {
+    if (code < 0x80) out.push_back(code);
+    else if (code < 0x800) {
+        out.push_back(0xC0 | (code >> 6));
+        out.push_back(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000) {
+        out.push_back(0xE0 | (code >> 12));
+        out.push_back(0x80 | ((code >> 6) & 0x3F));
+        out.push_back(0x80 | (code & 0x3F));
+    }
+    else {
+        out.push_back(0xF0 | (code >> 18));
+        out.push_back(0x80 | ((code >> 12) & 0x3F));
+        out.push_back(0x80 | ((code >> 6) & 0x3F));
+        out.push_back(0x80 | (code & 0x3F));
+    }
+}
+
+inline bool read_hex4(const char*& p, const char* end, uint32_t& code) {
+    if (end - p < 4) return false;
+    auto [next, ec] = from_chars(p, p + 4, code, 16);
+    if (ec != errc() || next != p + 4) return false;
+    p = next;
+    return true;
+}
+
+// Decodes the JSON string starting at the quote at p into out and moves p
+// past its closing quote; false if it is malformed, a lone or misplaced
+// surrogate included.
+inline bool read_json_string(const char*& p, const char* end, string& out) {
+    out.clear();
+    if (p == end || *p != '"') return false;
+    p++;
+    while (p < end) {
+        char c = *p++;
+        if (c == '"') return true;
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        if (p == end) return false;
+        char e = *p++;
+        switch (e) {
+            case '"': case '\\': case '/': out.push_back(e); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t code;
+                if (!read_hex4(p, end, code) || (code >= 0xDC00 && code < 0xE000)) return false;
+                if (code >= 0xD800 && code < 0xDC00) {
+                    uint32_t low;
+                    if (end - p < 2 || p[0] != '\\' || p[1] != 'u') return false;
+                    p += 2;
+                    if (!read_hex4(p, end, low) || low < 0xDC00 || low >= 0xE000) return false;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+// Reads id, title and len from a doc_info.jsonl line; false if the line does
+// not have the usual shape. The fields are looked for in the order they are
+// written, each after the value before it, so key-like text inside a title
+// (`\"len\": 5`) is never taken for a key.
+inline bool parse_doc_line(string_view line, int& pageId, string& title, uint32_t& length) {
+    const char* end = line.data() + line.size();
+    auto valueOf = [&line, end](const char* from, string_view name) -> const char* {
+        size_t at = line.find(name, from - line.data());
+        if (at == string_view::npos) return nullptr;
+        const char* p = line.data() + at + name.size();
+        while (p < end && *p == ' ') p++;
+        return p;
+    };
+
+    const char* p = valueOf(line.data(), "\"id\":");
+    if (p == nullptr) return false;
+    auto [afterId, ec] = from_chars(p, end, pageId);
+    if (ec != errc()) return false;
+    p = valueOf(afterId, "\"title\":");
+    if (p == nullptr || !read_json_string(p, end, title)) return false;
+    p = valueOf(p, "\"len\":");
+    return p != nullptr && from_chars(p, end, length).ec == errc();
+}
+
+#endif // DOC_INFO_HPP
@@ -1,287 +1,1354 @@
 #include <iostream>
-#include <map>
+#include <vector>
+#include <numeric>
+#include <cstring>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
+#include <chrono>
 #include <string>
 #include <limits>
+#include <unordered_map>
+#include <charconv>
+#include <functional>
+#include <queue>
+#include <string_view>
 #include "json.hpp"
+#include "doc_info.hpp"
+#include "fst.hpp"
+#include "index_format.hpp"
+#include "mmap_file.hpp"
+#include "score_file.hpp"
+#include "thread_pool.hpp"
+#include "title_store.hpp"
 using json = nlohmann::json;
 using namespace std;
 
 const string DOC_INFO_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\data_files\\doc_info.jsonl";
 const string TRIE_BINARY_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\trie2.bin";
-const string PAGERANK_SCORES_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\pagerank_scores.csv";
-
-unordered_map<int, double> pagerank_scores;
-
+const string PAGERANK_SCORES_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\pagerank_scores.bin";
+const string TITLE_STORE_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\titles.bin";
+const string FST_BINARY_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\suggest.fst";
+
+PageRankScores pagerank_scores;
+
+// trie2.bin is the in-memory layout itself and is used in place from a
+// read-only mapping, so loading costs nothing and every process running
+// autocomplete shares one copy in the page cache. It holds two tries of the
+// same shape, one over whole titles and one over the words inside them:
+//   TrieFileHeader
+//   per trie, at the positions in its TrieSection:
+//   TrieNode      nodes[numNodes]
+//   uint8         labels[numNodes]
+//   uint32        tops[numTops]
+//   TrieTitle     titles[numTitles]
+// Sections start on 64-byte boundaries; the checksum is FNV-1a over the
+// header bytes before it. The title text lives in titles.bin
+// (title_store.hpp), written by the same build; the header records that
+// file's checksum so a mismatched pair is refused.
+const char TRIE_MAGIC[8] = {'W', 'K', 'T', 'R', 'I', 'E', '\0', '\0'};
+const uint32_t TRIE_VERSION = 6;
+
+// Suggestions kept per node. A node with more than TOP_K titles below it stores
+// its TOP_K best titles, so a prefix lookup never ranks a large subtree;
+// smaller subtrees are ranked on the spot, which touches at most TOP_K titles.
+const int TOP_K = 10;
+
+// The word trie is keyed by two words, so a longer query is matched there on
+// its first two; at most this many titles holding them, best first, are then
+// read and checked against the rest of the query (see SUGGEST_BUDGET).
+const uint32_t INFIX_SCAN_LIMIT = 1024;
+
+// Typo tolerance. Queries of 3 to 5 bytes may be 1 edit (insertion, deletion
+// or substitution) away from a title prefix, longer ones 2. Each edit
+// multiplies a title's score by FUZZY_EDIT_PENALTY when it is ranked against
+// exact matches.
+const double FUZZY_EDIT_PENALTY = 0.1;
+
+// Titles are at most 255 bytes (MediaWiki's limit), so a longer query is more
+// than 2 edits from every title prefix and the typo search is skipped. This
+// also keeps its cost per node, one row of query length, small.
+const size_t FUZZY_MAX_QUERY = 255 + 2;
+
+// Time allowed per request for the open-ended parts, the search for prefixes
+// a few edits away and the title scan of a long infix query. Both stop when
+// it runs out and keep what they found; exact trie lookups always finish.
+const chrono::microseconds SUGGEST_BUDGET(1000);
+
+// Nodes are stored in one array with the root first; the children of a node
+// are a contiguous run and their labels sit next to each other in `labels`.
+// Titles are sorted by key, which makes the titles under any node a
+// contiguous range too.
 struct TrieNode{
-    map<char, TrieNode*> children;
-    bool isEnd;
-    string fullTitle;
+    uint32_t firstChild;    // children are firstChild .. firstChild + numChildren - 1
+    uint32_t firstTitle;    // titles below are firstTitle .. firstTitle + numTitles - 1,
+    uint32_t numTitles;     // those whose key ends here first
+    uint32_t firstTop;      // best titles are tops[firstTop .. firstTop + numTop - 1]
+    uint16_t numChildren;
+    uint8_t numTop;         // when numTitles > TOP_K: TOP_K, or every page if there are fewer
+    uint8_t isEnd;
+};
+
+struct TrieTitle{
     double score;
-    int pageId;
+    int32_t pageId;
+    uint32_t row;           // in titles.bin
+};
 
-    TrieNode(){
-        isEnd = false;
-        fullTitle = "";
-        score = 0;
-        pageId = 0;
-    }
+struct TrieSection{
+    uint64_t numNodes;
+    uint64_t numTops;
+    uint64_t numTitles;
+    uint64_t nodesPos;
+    uint64_t labelsPos;
+    uint64_t topsPos;
+    uint64_t titlesPos;
+};
+
+struct TrieFileHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t topK;
+    uint32_t reserved;
+    uint64_t titleStoreChecksum;
+    TrieSection prefixes;
+    TrieSection words;
+    uint64_t checksum;
+};
 
+uint64_t trie_align(uint64_t pos){
+    return (pos + 63) & ~uint64_t(63);
+}
+
+// suggest.fst is the other engine (--engine fst), built next to trie2.bin and
+// mapped the same way. It needs neither trie2.bin nor any top-k lists:
+//   FstFileHeader
+//   TrieTitle     titles[numTitles]          sorted by key, as in the title trie
+//   per FST, at the positions in its FstSection:
+//   uint8         bytes[numBytes]            states, see fst.hpp
+//   uint32        keyEntries[numKeys + 1]    only if a key has several entries
+//   uint32        entryTitles[numEntries]    only if entries are not the titles
+// The title FST has one entry per key, the title itself; the word FST maps
+// each word pair to the titles holding it. Sections start on 64-byte
+// boundaries; the checksum is FNV-1a over the header bytes before it.
+const char FST_MAGIC[8] = {'W', 'K', 'F', 'S', 'T', '\0', '\0', '\0'};
+const uint32_t FST_VERSION = 1;
+
+// FST weights are scores on a 16-bit log scale over 1e-12 .. 1, 5461 codes
+// per factor of 10 (about 4e-4 apart in relative terms); 0 means no score.
+// An edit costs a factor FUZZY_EDIT_PENALTY = 0.1, exactly FST_EDIT_CODES
+// codes, so typo matches are ranked on the same scale.
+const int32_t FST_CODES_PER_DECADE = 5461;
+const int32_t FST_EDIT_CODES = FST_CODES_PER_DECADE;
+const double FST_LOG_MIN = log(1e-12);
+const double FST_LOG_STEP = log(10.0) / FST_CODES_PER_DECADE;
+
+// Entries a best-first search still reads once it has its pages, to let the
+// exact scores order titles whose weights tie.
+const int FST_TIE_SCAN = 256;
+
+struct FstSection{
+    uint64_t numBytes;
+    uint64_t numKeys;
+    uint64_t numEntries;
+    uint32_t root;
+    int32_t rootWeight;
+    uint64_t bytesPos;
+    uint64_t keyEntriesPos;     // 0 if absent
+    uint64_t entryTitlesPos;    // 0 if absent
 };
 
+struct FstFileHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t titleStoreChecksum;
+    uint64_t numTitles;
+    uint64_t titlesPos;
+    FstSection prefixes;
+    FstSection words;
+    uint64_t checksum;
+};
+
+int32_t fstWeight(double score){
+    if(!(score > 0)) return 0;
+    double code = 1.0 + round((log(score) - FST_LOG_MIN) / FST_LOG_STEP);
+    return static_cast<int32_t>(min(65535.0, max(1.0, code)));
+}
+
+// Letters, digits and the bytes of multibyte UTF-8 characters, so accented
+// words stay whole. A word starts at a word byte that follows any other byte.
+bool isWordByte(unsigned char c){
+    return isalnum(c) || c >= 0x80;
+}
+
+// End of the word starting at `at` and of the word after it, or the end of
+// text if there is no word after it.
+size_t wordPairEnd(string_view text, size_t at){
+    while(at < text.size() && isWordByte(text[at])) at++;
+    while(at < text.size() && !isWordByte(text[at])) at++;
+    while(at < text.size() && isWordByte(text[at])) at++;
+    return at;
+}
+
 struct Suggestion{
     string title;
     int pageId;
     double score;
+    int edits = 0;          // from the query to the matched prefix
 };
 
-class Trie{
-private:
-    TrieNode* root;
-    long long nodesSaved;
-    long long totalNodes;
+int fuzzyEdits(size_t queryLength){
+    return queryLength < 3 ? 0 : queryLength < 6 ? 1 : 2;
+}
 
-    void dfs(TrieNode* node, vector<Suggestion>& results){
+double penalizedScore(double score, int edits){
+    return score * pow(FUZZY_EDIT_PENALTY, edits);
+}
 
-        if(node->isEnd){
-                results.push_back({node->fullTitle, node->pageId, node->score});
+// Fills next, the edit-distance row one label deeper than row, and returns
+// its smallest entry.
+int nextEditRow(const vector<int>& row, vector<int>& next, string_view query, unsigned char label){
+    next[0] = row[0] + 1;
+    int lowest = next[0];
+    for(size_t j = 1; j <= query.size(); j++){
+        int substitution = row[j - 1] + (static_cast<unsigned char>(query[j - 1]) != label);
+        next[j] = min({row[j] + 1, next[j - 1] + 1, substitution});
+        lowest = min(lowest, next[j]);
+    }
+    return lowest;
+}
+
+// Where a query prefix leads in an index: a trie node, or an FST state with
+// the rank of the first key below it and the weight of the best one. Node 0
+// means the prefix has left the index.
+struct Cursor{
+    uint32_t node;
+    uint32_t rank;
+    int32_t weight;
+};
+
+// Sorts (entry, edits) pairs by score with the edit penalty, then fewer
+// edits, then page id, keeps each page's first and at most limit.
+template <typename Index>
+void rankNear(const Index& index, vector<pair<uint32_t, int>>& found, int limit){
+    struct Ranked{
+        double rank;
+        int edits;
+        int pageId;
+        uint32_t e;
+    };
+    vector<Ranked> ranked;
+    ranked.reserve(found.size());
+    for(const auto& [e, edits] : found) ranked.push_back({penalizedScore(index.entry(e).score, edits), edits, index.entry(e).pageId, e});
+    sort(ranked.begin(), ranked.end(), [](const Ranked& a, const Ranked& b){
+        if(a.rank != b.rank) return a.rank > b.rank;
+        if(a.edits != b.edits) return a.edits < b.edits;
+        return a.pageId < b.pageId;
+    });
+    found.clear();
+    for(size_t i = 0; i < ranked.size() && static_cast<int>(found.size()) < limit; i++){
+        int pageId = ranked[i].pageId;
+        bool listed = any_of(ranked.begin(), ranked.begin() + i, [pageId](const Ranked& r){ return r.pageId == pageId; });
+        if(!listed) found.push_back({ranked[i].e, ranked[i].edits});
+    }
+}
+
+// One flat trie with per-node top-k lists over sorted (key, title) entries.
+// A key may be shared by several entries and a page may sit under several
+// keys; the top-k lists hold distinct pages.
+class TrieIndex{
+public:
+    // Point into the mapped trie2.bin, or into the built* vectors after build().
+    const TrieNode* nodes = nullptr;
+    const unsigned char* labels = nullptr;
+    const uint32_t* tops = nullptr;
+    const TrieTitle* titles = nullptr;
+    uint64_t numNodes = 0;
+    uint64_t numTops = 0;
+    uint64_t numTitles = 0;
+
+    // Best first; equal scores by page id so the order does not depend on the build.
+    bool better(uint32_t a, uint32_t b) const{
+        if(titles[a].score != titles[b].score) return titles[a].score > titles[b].score;
+        return titles[a].pageId < titles[b].pageId;
+    }
+
+    const TrieTitle& entry(uint32_t t) const{ return titles[t]; }
+
+    Cursor root() const{ return {0, 0, 0}; }
+
+    // Child under label, node 0 if there is none (the root is nobody's child).
+    Cursor child(const Cursor& at, unsigned char label) const{
+        uint32_t first = nodes[at.node].firstChild;
+        uint32_t last = first + nodes[at.node].numChildren;
+        for(uint32_t c = first; c < last; c++){
+            if(labels[c] == label) return {c, 0, 0};
         }
+        return {0, 0, 0};
+    }
+
+    // Titles whose key ends exactly at the node, best first; they open its range.
+    pair<uint32_t, uint32_t> own(const Cursor& at) const{
+        const TrieNode& n = nodes[at.node];
+        if(n.numChildren == 0) return {n.firstTitle, n.firstTitle + n.numTitles};
+        return {n.firstTitle, nodes[n.firstChild].firstTitle};
+    }
 
-        for(auto const&[key, child] : node->children){
-            dfs(child, results);
+    // The best limit titles below the node, one per page, best first.
+    vector<uint32_t> best(const Cursor& at, int limit) const{
+        const TrieNode& n = nodes[at.node];
+        vector<uint32_t> result;
+        if(n.numTop > 0 && (limit <= n.numTop || n.numTop < TOP_K)){
+            result.assign(tops + n.firstTop, tops + n.firstTop + min<int>(limit, n.numTop));
+            return result;
         }
+        result.resize(n.numTitles);
+        iota(result.begin(), result.end(), n.firstTitle);
+        rankDistinct(result, limit);
+        return result;
     }
 
-    void deleteNodes(TrieNode* node){
-        if(!node) return;
-        for(auto const& [key, child] : node->children){
-            deleteNodes(child);
+    // The best limit titles below any of the nodes found by fuzzyNodes, with
+    // their edits, one per page, best first by score with the edit penalty.
+    vector<pair<uint32_t, int>> bestNear(const vector<pair<Cursor, int>>& found, int limit) const{
+        vector<pair<uint32_t, int>> result;
+        for(const auto& [at, edits] : found){
+            for(uint32_t t : best(at, limit)) result.push_back({t, edits});
         }
-        delete node;
+        rankNear(*this, result, limit);
+        return result;
     }
 
-    void serialize(TrieNode* node, ofstream& out){
-        if(!node) return;
+    // Nodes whose text is within maxEdits of query but not equal to it, with
+    // that distance. Walks the trie carrying one row of the edit-distance
+    // table per depth and stops early once the deadline passes.
+    void fuzzyNodes(string_view query, int maxEdits, chrono::steady_clock::time_point deadline, vector<pair<Cursor, int>>& found) const{
+        if(numNodes == 0) return;
+        // Rows are added as the walk goes deeper, which is at most maxEdits
+        // past the query.
+        vector<vector<int>> rows(1, vector<int>(query.size() + 1));
+        iota(rows[0].begin(), rows[0].end(), 0);
+        size_t visited = 0;
+        fuzzyWalk(0, 0, query, maxEdits, deadline, rows, visited, found);
+    }
+
+    // entries[t] is filed under keys[t]; both must be sorted by key, and
+    // entries sharing a key ordered best first.
+    void build(const vector<string_view>& keys, vector<TrieTitle>&& entries){
+        builtTitles = move(entries);
+        titles = builtTitles.data();
+        numTitles = builtTitles.size();
+        layoutNodes(keys);
+
+        nodes = builtNodes.data();
+        labels = builtLabels.data();
+        tops = builtTops.data();
+        numNodes = builtNodes.size();
+        numTops = builtTops.size();
+    }
 
-        nodesSaved++;
+    double megabytes() const{
+        return (numNodes * (sizeof(TrieNode) + 1) + numTops * sizeof(uint32_t) + numTitles * sizeof(TrieTitle)) / 1048576.0;
+    }
 
+    // Assigns 64-byte aligned positions from pos on.
+    TrieSection section(uint64_t& pos) const{
+        TrieSection s = {numNodes, numTops, numTitles, 0, 0, 0, 0};
+        s.nodesPos = trie_align(pos);
+        s.labelsPos = trie_align(s.nodesPos + numNodes * sizeof(TrieNode));
+        s.topsPos = trie_align(s.labelsPos + numNodes);
+        s.titlesPos = trie_align(s.topsPos + numTops * sizeof(uint32_t));
+        pos = s.titlesPos + numTitles * sizeof(TrieTitle);
+        return s;
+    }
 
-        out.write(reinterpret_cast<const char*>(&node->isEnd), sizeof(node->isEnd));
-        
-        if(node->isEnd){
-            out.write(reinterpret_cast<const char*>(&node->score), sizeof(node->score));
-            out.write(reinterpret_cast<const char*>(&node->pageId), sizeof(node->pageId));
+    // Points the arrays into a mapped file, false if the section does not fit.
+    bool attach(const char* base, uint64_t size, const TrieSection& s){
+        bool inside = s.nodesPos + s.numNodes * sizeof(TrieNode) <= size
+                   && s.labelsPos + s.numNodes <= size
+                   && s.topsPos + s.numTops * sizeof(uint32_t) <= size
+                   && s.titlesPos + s.numTitles * sizeof(TrieTitle) <= size;
+        if(!inside || s.numNodes == 0) return false;
+        nodes = reinterpret_cast<const TrieNode*>(base + s.nodesPos);
+        labels = reinterpret_cast<const unsigned char*>(base + s.labelsPos);
+        tops = reinterpret_cast<const uint32_t*>(base + s.topsPos);
+        titles = reinterpret_cast<const TrieTitle*>(base + s.titlesPos);
+        numNodes = s.numNodes;
+        numTops = s.numTops;
+        numTitles = s.numTitles;
+        return true;
+    }
 
-            size_t len = node->fullTitle.length();
-            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
-            out.write(node->fullTitle.c_str(), len);              
+private:
+    vector<TrieNode> builtNodes;
+    vector<unsigned char> builtLabels;
+    vector<uint32_t> builtTops;
+    vector<TrieTitle> builtTitles;
+
+    // Fills rows[depth + 1] for each child of node; false once out of time.
+    bool fuzzyWalk(uint32_t node, size_t depth, string_view query, int maxEdits, chrono::steady_clock::time_point deadline,
+                   vector<vector<int>>& rows, size_t& visited, vector<pair<Cursor, int>>& found) const{
+        if(rows.size() == depth + 1) rows.emplace_back(query.size() + 1);
+        uint32_t first = nodes[node].firstChild;
+        for(uint32_t c = first; c < first + nodes[node].numChildren; c++){
+            if(++visited % 256 == 0 && chrono::steady_clock::now() > deadline) return false;
+            int lowest = nextEditRow(rows[depth], rows[depth + 1], query, labels[c]);
+            int distance = rows[depth + 1][query.size()];
+            bool match = distance <= maxEdits;
+            if(match && distance > 0) found.push_back({{c, 0, 0}, distance});
+            // No node below c is closer than the lowest entry of its row, and
+            // c's own titles already cover them at `distance`.
+            if(lowest <= maxEdits && (!match || lowest < distance)){
+                if(!fuzzyWalk(c, depth + 1, query, maxEdits, deadline, rows, visited, found)) return false;
+            }
         }
+        return true;
+    }
 
-        size_t num_children = node->children.size();
-        out.write(reinterpret_cast<const char*>(&num_children), sizeof(num_children));
+    // Sorts best first, drops repeated pages and keeps at most limit.
+    void rankDistinct(vector<uint32_t>& candidates, size_t limit) const{
+        sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b){ return better(a, b); });
+        auto samePage = [this](uint32_t a, uint32_t b){ return titles[a].pageId == titles[b].pageId; };
+        candidates.erase(unique(candidates.begin(), candidates.end(), samePage), candidates.end());
+        if(candidates.size() > limit) candidates.resize(limit);
+    }
 
-        for(auto const &[key, child] : node->children){
-            out.write(reinterpret_cast<const char*>(&key), sizeof(key));
-            serialize(child, out);
+    // A node under construction: the nodes along the current key are open,
+    // and a node is finished when a key leaves it.
+    struct OpenNode{
+        uint32_t firstTitle;
+        uint32_t own;                       // titles whose key ends here
+        unsigned char label;
+        vector<TrieNode> children;          // finished, in label order
+        vector<unsigned char> childLabels;
+    };
+
+    // One pass over the sorted keys. When a node is finished all its children
+    // are too; they are written out as one block and ranked into its top-k
+    // list there and then. The root is node 0, the other blocks follow in the
+    // order their parents finish.
+    void layoutNodes(const vector<string_view>& keys){
+        // A key adds a node for each byte past the prefix it shares with the key before it.
+        auto shared = [&keys](size_t t){
+            if(t == 0 || t == keys.size()) return size_t(0);
+            size_t n = 0, limit = min(keys[t - 1].size(), keys[t].size());
+            while(n < limit && keys[t - 1][n] == keys[t][n]) n++;
+            return n;
+        };
+        size_t count = 1;
+        for(size_t t = 0; t < keys.size(); t++) count += keys[t].size() - shared(t);
+        builtNodes.clear();
+        builtLabels.clear();
+        builtTops.clear();
+        builtNodes.reserve(count);
+        builtLabels.reserve(count);
+        builtNodes.push_back({});
+        builtLabels.push_back(0);
+
+        vector<uint32_t> candidates;
+        auto finish = [&](OpenNode& open, uint32_t end){
+            TrieNode node = {static_cast<uint32_t>(builtNodes.size()), open.firstTitle, end - open.firstTitle, 0,
+                             static_cast<uint16_t>(open.children.size()), 0, open.own > 0};
+            builtNodes.insert(builtNodes.end(), open.children.begin(), open.children.end());
+            builtLabels.insert(builtLabels.end(), open.childLabels.begin(), open.childLabels.end());
+            if(node.numTitles <= TOP_K) return node;
+
+            // Own titles are best first, so only the first TOP_K pages among them can place.
+            candidates.clear();
+            for(uint32_t t = open.firstTitle; t < open.firstTitle + open.own && candidates.size() < TOP_K; t++){
+                bool seen = false;
+                for(uint32_t c : candidates) seen = seen || titles[c].pageId == titles[t].pageId;
+                if(!seen) candidates.push_back(t);
+            }
+            for(const TrieNode& ch : open.children){
+                if(ch.numTop > 0) candidates.insert(candidates.end(), builtTops.begin() + ch.firstTop, builtTops.begin() + ch.firstTop + ch.numTop);
+                else for(uint32_t t = ch.firstTitle; t < ch.firstTitle + ch.numTitles; t++) candidates.push_back(t);
+            }
+            rankDistinct(candidates, TOP_K);
+            node.firstTop = builtTops.size();
+            node.numTop = candidates.size();
+            builtTops.insert(builtTops.end(), candidates.begin(), candidates.end());
+            return node;
+        };
+
+        // open[d] is the node at depth d along the current key.
+        vector<OpenNode> open(1);
+        open[0].firstTitle = 0;
+        open[0].own = 0;
+        size_t depth = 0;
+        for(uint32_t t = 0; t <= keys.size(); t++){
+            size_t keep = shared(t);
+            for(; depth > keep; depth--){
+                TrieNode node = finish(open[depth], t);
+                open[depth - 1].children.push_back(node);
+                open[depth - 1].childLabels.push_back(open[depth].label);
+            }
+            if(t == keys.size()) break;
+            for(; depth < keys[t].size(); depth++){
+                if(open.size() == depth + 1) open.emplace_back();
+                OpenNode& next = open[depth + 1];
+                next.firstTitle = t;
+                next.own = 0;
+                next.label = keys[t][depth];
+                next.children.clear();
+                next.childLabels.clear();
+            }
+            open[depth].own++;
         }
+        builtNodes[0] = finish(open[0], keys.size());
     }
+};
 
-    TrieNode* deserialize(ifstream& in){
-        TrieNode* node = new TrieNode();
+// The FST engine's counterpart of TrieIndex: the same sorted keys as a
+// minimal acyclic FST (fst.hpp), in which a path adds up to its key's rank
+// and weight. It keeps no top-k lists; the best titles under a state are
+// found by a best-first search on the pushed weights. A key has one or more
+// entries, best first, and an entry names a title.
+class FstIndex{
+public:
+    // Point into the mapped FST file, or into the built* members after build().
+    Fst fst;
+    uint32_t rootState = 0;
+    int32_t rootWeight = 0;
+    uint64_t numKeys = 0;
+    uint64_t numEntries = 0;
+    uint64_t numBytes = 0;
+    const TrieTitle* titles = nullptr;          // shared by both indexes
+    const uint32_t* keyEntries = nullptr;       // entries of key k start at keyEntries[k]; null if key k is entry k
+    const uint32_t* entryTitles = nullptr;      // null if entry e is title e
+
+    const TrieTitle& entry(uint32_t e) const{ return titles[entryTitles ? entryTitles[e] : e]; }
+
+    Cursor root() const{ return {rootState, 0, rootWeight}; }
+
+    // Child under label, node 0 if there is none.
+    Cursor child(const Cursor& at, unsigned char label) const{
+        FstArc arc;
+        if(!fst.child(at.node, label, arc)) return {0, 0, 0};
+        return {arc.target, at.rank + arc.output, at.weight - arc.penalty};
+    }
 
-        in.read(reinterpret_cast<char*>(&node->isEnd), sizeof(node->isEnd));
-        if(in.eof()){
-            delete node;
-            return nullptr;
-        }
+    // Entries of the key ending exactly at the state, best first.
+    pair<uint32_t, uint32_t> own(const Cursor& at) const{
+        int32_t penalty;
+        if(!fst.final(at.node, penalty)) return {0, 0};
+        return keyRange(at.rank);
+    }
 
-        if(node->isEnd){
-            in.read(reinterpret_cast<char*>(&node->score), sizeof(node->score));
-            in.read(reinterpret_cast<char*>(&node->pageId), sizeof(node->pageId));
+    // The best limit titles below the state, one per page, best first.
+    vector<uint32_t> best(const Cursor& at, int limit) const{
+        vector<uint32_t> result;
+        for(const auto& [e, edits] : search({{at, 0}}, limit)) result.push_back(e);
+        return result;
+    }
 
-            size_t len;
-            in.read(reinterpret_cast<char*>(&len), sizeof(len));
-            node->fullTitle.resize(len);
-            in.read(node->fullTitle.data(), len);
-        }
+    // As TrieIndex::bestNear, in one search from all the states at once.
+    vector<pair<uint32_t, int>> bestNear(const vector<pair<Cursor, int>>& found, int limit) const{
+        return search(found, limit);
+    }
 
-        size_t num_children;
-        in.read(reinterpret_cast<char*>(&num_children), sizeof(num_children));
+    // As TrieIndex::fuzzyNodes. The FST is a graph, so a shared state is
+    // walked once per prefix leading to it.
+    void fuzzyNodes(string_view query, int maxEdits, chrono::steady_clock::time_point deadline, vector<pair<Cursor, int>>& found) const{
+        if(numKeys == 0) return;
+        vector<vector<int>> rows(1, vector<int>(query.size() + 1));
+        iota(rows[0].begin(), rows[0].end(), 0);
+        size_t visited = 0;
+        fuzzyWalk(root(), 0, query, maxEdits, deadline, rows, visited, found);
+    }
 
-        for(size_t i=0; i<num_children; i++){
-            char key;
-            in.read(reinterpret_cast<char*>(&key), sizeof(key));
-            node->children[key] = deserialize(in);
+    // keys[e] is the key of entry e and titleOf[e] its title (empty if entry
+    // e is title e). Keys must be sorted and entries sharing a key ordered
+    // best first; a key's weight is that of its first entry.
+    void build(const vector<string_view>& keys, vector<uint32_t>&& titleOf, const vector<int32_t>& titleWeights){
+        builtEntryTitles = move(titleOf);
+        builtKeyEntries.clear();
+        FstBuilder builder;
+        for(uint32_t e = 0; e < keys.size(); e++){
+            if(e > 0 && keys[e] == keys[e - 1]) continue;
+            builtKeyEntries.push_back(e);
+            builder.add(keys[e], titleWeights[builtEntryTitles.empty() ? e : builtEntryTitles[e]]);
         }
+        numKeys = builtKeyEntries.size();
+        numEntries = keys.size();
+        builtKeyEntries.push_back(keys.size());
+        if(numKeys == numEntries) vector<uint32_t>().swap(builtKeyEntries);
+        builder.finish();
+        builtBytes = builder.data();
+        numBytes = builtBytes.size();
+        rootState = builder.root();
+        rootWeight = builder.bestWeight();
+        numStates = builder.states();
+
+        fst.attach(builtBytes.data());
+        keyEntries = builtKeyEntries.empty() ? nullptr : builtKeyEntries.data();
+        entryTitles = builtEntryTitles.empty() ? nullptr : builtEntryTitles.data();
+    }
+
+    uint64_t states() const{ return numStates; }
 
-        return node;
+    double megabytes() const{
+        return (numBytes + (keyEntries ? (numKeys + 1) * sizeof(uint32_t) : 0) + (entryTitles ? numEntries * sizeof(uint32_t) : 0)) / 1048576.0;
     }
 
+    // Assigns 64-byte aligned positions from pos on.
+    FstSection section(uint64_t& pos) const{
+        FstSection s = {numBytes, numKeys, numEntries, rootState, rootWeight, 0, 0, 0};
+        s.bytesPos = trie_align(pos);
+        pos = s.bytesPos + numBytes;
+        if(keyEntries){
+            s.keyEntriesPos = trie_align(pos);
+            pos = s.keyEntriesPos + (numKeys + 1) * sizeof(uint32_t);
+        }
+        if(entryTitles){
+            s.entryTitlesPos = trie_align(pos);
+            pos = s.entryTitlesPos + numEntries * sizeof(uint32_t);
+        }
+        return s;
+    }
 
-public:
+    void write(const FstSection& s, const function<void(uint64_t, const void*, uint64_t)>& writeAt) const{
+        writeAt(s.bytesPos, builtBytes.data(), numBytes);
+        if(keyEntries) writeAt(s.keyEntriesPos, keyEntries, (numKeys + 1) * sizeof(uint32_t));
+        if(entryTitles) writeAt(s.entryTitlesPos, entryTitles, numEntries * sizeof(uint32_t));
+    }
 
-    Trie(){
-        root = new TrieNode();
-        nodesSaved = 0;
-        totalNodes = 1;
+    // Points into a mapped file, false if the section does not fit.
+    bool attach(const char* base, uint64_t size, const FstSection& s, const TrieTitle* allTitles){
+        bool inside = s.bytesPos + s.numBytes <= size
+                   && (s.keyEntriesPos == 0 || s.keyEntriesPos + (s.numKeys + 1) * sizeof(uint32_t) <= size)
+                   && (s.entryTitlesPos == 0 || s.entryTitlesPos + s.numEntries * sizeof(uint32_t) <= size)
+                   && s.root > 0 && s.root < s.numBytes;
+        if(!inside) return false;
+        fst.attach(base + s.bytesPos);
+        keyEntries = s.keyEntriesPos ? reinterpret_cast<const uint32_t*>(base + s.keyEntriesPos) : nullptr;
+        entryTitles = s.entryTitlesPos ? reinterpret_cast<const uint32_t*>(base + s.entryTitlesPos) : nullptr;
+        titles = allTitles;
+        rootState = s.root;
+        rootWeight = s.rootWeight;
+        numKeys = s.numKeys;
+        numEntries = s.numEntries;
+        numBytes = s.numBytes;
+        return true;
     }
 
+private:
+    string builtBytes;
+    vector<uint32_t> builtKeyEntries;
+    vector<uint32_t> builtEntryTitles;
+    uint64_t numStates = 0;
+
+    pair<uint32_t, uint32_t> keyRange(uint32_t key) const{
+        if(keyEntries == nullptr) return {key, key + 1};
+        return {keyEntries[key], keyEntries[key + 1]};
+    }
+
+    // Best-first search from several states, each with its edits. States and
+    // entries are popped by weight less FST_EDIT_CODES per edit, so entries
+    // come out in (quantized) penalized score order. Once limit pages are in,
+    // the entries that tie with the last of them are still read, up to
+    // FST_TIE_SCAN, and the exact scores then decide.
+    vector<pair<uint32_t, int>> search(const vector<pair<Cursor, int>>& starts, int limit) const{
+        struct Item{
+            int32_t bound;      // penalized weight of the best entry this item can yield
+            uint32_t node;      // a state, or 0 for entry `first` of a key ending at `last`
+            uint32_t first;     // for a state, the rank of its first key
+            uint32_t last;
+            int edits;
+            bool operator<(const Item& o) const{ return bound < o.bound; }
+        };
+        priority_queue<Item> queue;
+        for(const auto& [at, edits] : starts) queue.push({at.weight - edits * FST_EDIT_CODES, at.node, at.rank, 0, edits});
+        vector<pair<uint32_t, int>> found;
+        int pages = 0;
+        int32_t cutoff = 0;
+        int ties = 0;
+        while(!queue.empty()){
+            Item item = queue.top();
+            if(pages >= limit && (item.bound < cutoff || ++ties > FST_TIE_SCAN)) break;
+            queue.pop();
+            if(item.node == 0){
+                int pageId = entry(item.first).pageId;
+                bool seen = any_of(found.begin(), found.end(), [&](const pair<uint32_t, int>& f){ return entry(f.first).pageId == pageId; });
+                found.push_back({item.first, item.edits});
+                if(!seen && ++pages == limit) cutoff = item.bound;
+                if(item.first + 1 < item.last){
+                    int32_t bound = fstWeight(entry(item.first + 1).score) - item.edits * FST_EDIT_CODES;
+                    queue.push({bound, 0, item.first + 1, item.last, item.edits});
+                }
+                continue;
+            }
+            int32_t penalty;
+            if(fst.final(item.node, penalty)){
+                auto [first, last] = keyRange(item.first);
+                queue.push({item.bound - penalty, 0, first, last, item.edits});
+            }
+            fst.forEachArc(item.node, [&](unsigned char, const FstArc& arc){
+                queue.push({item.bound - arc.penalty, arc.target, item.first + arc.output, 0, item.edits});
+            });
+        }
+        rankNear(*this, found, limit);
+        return found;
+    }
 
-    void insert(const string& title, double score, int pageId){
-        TrieNode* current = root;
-        for(char ch : title){
-            ch = tolower(ch);
-            if(current->children.find(ch) == current->children.end()){
-                current->children[ch] = new TrieNode();
-                totalNodes++;
+    bool fuzzyWalk(const Cursor& at, size_t depth, string_view query, int maxEdits, chrono::steady_clock::time_point deadline,
+                   vector<vector<int>>& rows, size_t& visited, vector<pair<Cursor, int>>& found) const{
+        if(rows.size() == depth + 1) rows.emplace_back(query.size() + 1);
+        bool inTime = true;
+        fst.forEachArc(at.node, [&](unsigned char label, const FstArc& arc){
+            if(!inTime) return;
+            if(++visited % 256 == 0 && chrono::steady_clock::now() > deadline){
+                inTime = false;
+                return;
             }
-            current = current->children[ch];
+            Cursor c = {arc.target, at.rank + arc.output, at.weight - arc.penalty};
+            int lowest = nextEditRow(rows[depth], rows[depth + 1], query, label);
+            int distance = rows[depth + 1][query.size()];
+            bool match = distance <= maxEdits;
+            if(match && distance > 0) found.push_back({c, distance});
+            if(lowest <= maxEdits && (!match || lowest < distance)) inTime = fuzzyWalk(c, depth + 1, query, maxEdits, deadline, rows, visited, found);
+        });
+        return inTime;
+    }
+};
+
+// A query as typed so far and where each of its prefixes leads in both
+// indexes: titleNodes[i] is where text[0..i] leads, node 0 once the text has
+// left the index. Typing a byte adds one step and deleting one drops it, so
+// a session never walks from the root again.
+struct QueryPath{
+    string text;                    // lowercased
+    vector<Cursor> titleNodes;
+    vector<Cursor> wordNodes;
+};
+
+// Titles read for a build, in input order. The bytes of each title and of
+// its lowercased key sit back to back in one buffer, so a few million
+// titles cost a few allocations instead of two per title.
+struct TitleBatch{
+    struct Title{
+        uint64_t offset;    // title at text[offset ..], its key right after it
+        uint32_t size;
+        int pageId;
+        uint32_t length;
+        double score;
+    };
+    string text;
+    vector<Title> titles;
+
+    void add(string_view title, double score, int pageId, uint32_t length){
+        titles.push_back({text.size(), static_cast<uint32_t>(title.size()), pageId, length, score});
+        text.append(title);
+        for(char ch : title) text.push_back(tolower(ch));
+    }
+
+    void append(const TitleBatch& other){
+        uint64_t base = text.size();
+        text += other.text;
+        for(Title t : other.titles){
+            t.offset += base;
+            titles.push_back(t);
         }
-        current->isEnd = true;
-        current->fullTitle = title;
-        current->score = score; 
-        current->pageId = pageId;
     }
 
-    vector<Suggestion> getSuggestion(string prefix, int limit = 10){
-        TrieNode* current = root;
-        vector<Suggestion> candidates;
+    string_view title(uint32_t i) const{ return string_view(text).substr(titles[i].offset, titles[i].size); }
+    string_view key(uint32_t i) const{ return string_view(text).substr(titles[i].offset + titles[i].size, titles[i].size); }
+};
+
+// The first eight bytes of a key as a big-endian number, zero padded, so
+// unequal heads order like their keys and only ties need the keys compared.
+uint64_t keyHead(string_view key){
+    uint64_t head = 0;
+    for(size_t i = 0; i < 8; i++) head = (head << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+    return head;
+}
+
+class Trie{
+private:
+    TrieIndex prefixes;     // whole titles
+    TrieIndex words;        // every word of a title but the first, with the word after it
+    FstIndex fstPrefixes;   // the same keys for --engine fst
+    FstIndex fstWords;
+    bool useFst = false;
+    MappedFile file;
+    TitleStore store;
+
+    TitleBatch pending;
+
+    template <typename Index>
+    Suggestion suggestion(const Index& index, uint32_t e) const{
+        const TrieTitle& title = index.entry(e);
+        return {store.title(title.row), title.pageId, title.score};
+    }
 
-        for(char ch : prefix){
-            ch = tolower(ch);
-            if(current->children.find(ch) == current->children.end()){
-                return {};
+    template <typename Index>
+    vector<Suggestion> prefixMatches(const Index& prefixIndex, const QueryPath& query, int limit) const{
+        Cursor at = query.titleNodes.back();
+        if(at.node == 0) return {};
+        vector<Suggestion> matches;
+        for(uint32_t e : prefixIndex.best(at, limit)) matches.push_back(suggestion(prefixIndex, e));
+        return matches;
+    }
+
+    // Titles in which query starts at a word other than the first. A query of
+    // up to two words is a prefix lookup in the word index; a longer one is
+    // checked against the titles holding its first two words, best first.
+    template <typename Index>
+    vector<Suggestion> infixMatches(const Index& wordIndex, const QueryPath& path, int limit, chrono::steady_clock::time_point deadline) const{
+        const string& query = path.text;
+        if(!isWordByte(query[0])) return {};
+        size_t pairEnd = wordPairEnd(query, 0);
+        Cursor at = path.wordNodes[pairEnd - 1];
+        if(at.node == 0) return {};
+
+        vector<Suggestion> matches;
+        if(pairEnd == query.size()){
+            for(uint32_t e : wordIndex.best(at, limit)) matches.push_back(suggestion(wordIndex, e));
+            return matches;
+        }
+
+        auto [first, end] = wordIndex.own(at);
+        uint32_t last = first + min(end - first, INFIX_SCAN_LIMIT);
+        for(uint32_t e = first; e < last && static_cast<int>(matches.size()) < limit; e++){
+            if((e - first) % 64 == 63 && chrono::steady_clock::now() > deadline) break;
+            Suggestion s = suggestion(wordIndex, e);
+            string text = s.title;
+            for(char& ch : text) ch = tolower(ch);
+            for(size_t at = text.find(query, 1); at != string::npos; at = text.find(query, at + 1)){
+                if(!isWordByte(text[at - 1])){
+                    matches.push_back(move(s));
+                    break;
+                }
             }
-            current = current->children[ch];
         }
+        return matches;
+    }
 
-        dfs(current,candidates);
+    // Titles whose prefix, or a later word, is a few edits from the query.
+    // Candidates are ranked from the index entries; only the ones kept are
+    // read from the title store.
+    template <typename Index>
+    vector<Suggestion> fuzzyMatches(const Index& prefixIndex, const Index& wordIndex, const string& query, int limit, chrono::steady_clock::time_point deadline) const{
+        int maxEdits = fuzzyEdits(query.size());
+        if(maxEdits == 0 || query.size() > FUZZY_MAX_QUERY) return {};
+
+        struct Candidate{
+            const Index* index;
+            uint32_t e;
+            int edits;
+            double rank;
+        };
+        vector<Candidate> candidates;
+        vector<pair<Cursor, int>> found;
+        bool wordQuery = isWordByte(query[0]) && wordPairEnd(query, 0) == query.size();
+        for(const Index* index : {&prefixIndex, &wordIndex}){
+            if(index == &wordIndex && !wordQuery) continue;
+            found.clear();
+            index->fuzzyNodes(query, maxEdits, deadline, found);
+            for(const auto& [e, edits] : index->bestNear(found, limit)){
+                candidates.push_back({index, e, edits, penalizedScore(index->entry(e).score, edits)});
+            }
+        }
 
-        sort(candidates.begin(), candidates.end(), [](const Suggestion&a, const Suggestion& b){
-            return a.score > b.score;
+        auto pageOf = [](const Candidate& c){ return c.index->entry(c.e).pageId; };
+        sort(candidates.begin(), candidates.end(), [&pageOf](const Candidate& a, const Candidate& b){
+            if(a.rank != b.rank) return a.rank > b.rank;
+            if(a.edits != b.edits) return a.edits < b.edits;
+            return pageOf(a) < pageOf(b);
         });
-        
-        candidates.resize(limit);
-        return candidates;
+        vector<Suggestion> matches;
+        for(const Candidate& c : candidates){
+            if(static_cast<int>(matches.size()) == limit) break;
+            int pageId = pageOf(c);
+            bool listed = any_of(matches.begin(), matches.end(), [pageId](const Suggestion& m){ return m.pageId == pageId; });
+            if(listed) continue;
+            matches.push_back(suggestion(*c.index, c.e));
+            matches.back().edits = c.edits;
+        }
+        return matches;
     }
 
-    void saveToDisk(const string& filename){
-        ofstream outfile(filename, ios::binary);
-        serialize(root, outfile);
-        outfile.close();
+    // Titles starting with the query, titles with a later word starting with
+    // it, and titles a few edits away, merged by score with the edit penalty;
+    // a page found more than one way is listed once, at its best.
+    template <typename Index>
+    vector<Suggestion> suggest(const Index& prefixIndex, const Index& wordIndex, const QueryPath& query, int limit) const{
+        auto deadline = chrono::steady_clock::now() + SUGGEST_BUDGET;
+        vector<Suggestion> found = prefixMatches(prefixIndex, query, limit);
+        for(Suggestion& s : infixMatches(wordIndex, query, limit, deadline)) found.push_back(move(s));
+        for(Suggestion& s : fuzzyMatches(prefixIndex, wordIndex, query.text, limit, deadline)) found.push_back(move(s));
+
+        stable_sort(found.begin(), found.end(), [](const Suggestion& a, const Suggestion& b){
+            double x = penalizedScore(a.score, a.edits), y = penalizedScore(b.score, b.edits);
+            if(x != y) return x > y;
+            if(a.edits != b.edits) return a.edits < b.edits;
+            return a.pageId < b.pageId;
+        });
+        vector<Suggestion> merged;
+        for(Suggestion& s : found){
+            if(static_cast<int>(merged.size()) == limit) break;
+            bool listed = any_of(merged.begin(), merged.end(), [&s](const Suggestion& m){ return m.pageId == s.pageId; });
+            if(!listed) merged.push_back(move(s));
+        }
+        return merged;
     }
 
-    bool loadFromDisk(const string& filename){
-        ifstream infile(filename, ios::binary);
-        if(!infile.is_open()) return false;
-        deleteNodes(root);
+    // Appends text to the query, one step per byte and index.
+    template <typename Index>
+    void step(const Index& prefixIndex, const Index& wordIndex, QueryPath& query, const string& text) const{
+        for(char ch : text){
+            unsigned char label = tolower(ch);
+            bool atRoot = query.text.empty();
+            Cursor title = atRoot ? prefixIndex.root() : query.titleNodes.back();
+            Cursor word = atRoot ? wordIndex.root() : query.wordNodes.back();
+            query.titleNodes.push_back(atRoot || title.node ? prefixIndex.child(title, label) : title);
+            query.wordNodes.push_back(atRoot || word.node ? wordIndex.child(word, label) : word);
+            query.text.push_back(label);
+        }
+    }
 
-        root = deserialize(infile);
+public:
 
-        return root != nullptr && root->children.size() > 0;    
+    void insert(string_view title, double score, int pageId, uint32_t length){
+        pending.add(title, score, pageId, length);
     }
 
-    bool buildFromJSON(const string& filename){
-        ifstream infile(filename);
-        static char buffer[1024*1024];
-        infile.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
+    // Writes every inserted title to the title store at titlesPath and builds
+    // both tries and both FSTs over it. In these, a title whose lowercased
+    // text repeats an earlier one replaces it; the store keeps both pages.
+    // Sorting runs on the pool, then the store, the tries and the FSTs are
+    // built side by side.
+    bool build(const string& titlesPath, ThreadPool& pool){
+        struct KeyRef{
+            uint64_t head;
+            uint32_t index;
+        };
+        vector<KeyRef> order(pending.titles.size());
+        for(uint32_t i = 0; i < order.size(); i++) order[i] = {keyHead(pending.key(i)), i};
+        parallelStableSort(pool, order, [this](const KeyRef& a, const KeyRef& b){
+            if(a.head != b.head) return a.head < b.head;
+            return pending.key(a.index) < pending.key(b.index);
+        });
+
+        vector<string_view> keys;
+        vector<TrieTitle> entries;
+        for(size_t row = 0; row < order.size(); row++){
+            uint32_t i = order[row].index;
+            if(row + 1 < order.size() && pending.key(i) == pending.key(order[row + 1].index)) continue;
+            const TitleBatch::Title& title = pending.titles[i];
+            keys.push_back(pending.key(i));
+            entries.push_back({title.score, title.pageId, static_cast<uint32_t>(row)});
+        }
 
-        if(!infile.is_open()){
-            cerr << "Error: JSONL File not opening";
+        // Every word after the first, once per title, keyed by its text up to
+        // the end of the next word. Titles sharing a key are ordered best first.
+        struct WordRef{
+            uint64_t head;
+            string_view word;
+            uint32_t title;
+        };
+        vector<WordRef> wordEntries;
+        for(uint32_t t = 0; t < keys.size(); t++){
+            string_view key = keys[t];
+            size_t firstWord = wordEntries.size();
+            for(size_t at = 1; at < key.size(); at++){
+                if(!isWordByte(key[at]) || isWordByte(key[at - 1])) continue;
+                string_view word = key.substr(at, wordPairEnd(key, at) - at);
+                bool repeated = false;
+                for(size_t w = firstWord; w < wordEntries.size(); w++) repeated = repeated || wordEntries[w].word == word;
+                if(!repeated) wordEntries.push_back({keyHead(word), word, t});
+            }
+        }
+        parallelStableSort(pool, wordEntries, [&entries](const WordRef& a, const WordRef& b){
+            if(a.head != b.head) return a.head < b.head;
+            if(a.word != b.word) return a.word < b.word;
+            const TrieTitle& x = entries[a.title];
+            const TrieTitle& y = entries[b.title];
+            if(x.score != y.score) return x.score > y.score;
+            return x.pageId < y.pageId;
+        });
+        vector<string_view> wordKeys;
+        vector<TrieTitle> wordTitles;
+        vector<uint32_t> wordTitleIds;
+        wordKeys.reserve(wordEntries.size());
+        wordTitles.reserve(wordEntries.size());
+        wordTitleIds.reserve(wordEntries.size());
+        for(const WordRef& w : wordEntries){
+            wordKeys.push_back(w.word);
+            wordTitles.push_back(entries[w.title]);
+            wordTitleIds.push_back(w.title);
+        }
+        vector<WordRef>().swap(wordEntries);
+        vector<int32_t> titleWeights(entries.size());
+        for(size_t t = 0; t < entries.size(); t++) titleWeights[t] = fstWeight(entries[t].score);
+
+        file.close();
+        bool written = false;
+        uint64_t storeChecksum = 0;
+        pool.parallelFor(5, [&](unsigned job){
+            if(job == 0){
+                TitleStoreWriter writer;
+                for(const KeyRef& k : order) writer.add(pending.title(k.index), pending.titles[k.index].pageId, pending.titles[k.index].length);
+                written = writer.write(titlesPath, storeChecksum);
+            }
+            else if(job == 1) prefixes.build(keys, move(entries));
+            else if(job == 2) words.build(wordKeys, move(wordTitles));
+            else if(job == 3) fstPrefixes.build(keys, {}, titleWeights);
+            else fstWords.build(wordKeys, move(wordTitleIds), titleWeights);
+        });
+        fstPrefixes.titles = prefixes.titles;
+        fstWords.titles = prefixes.titles;
+        pending = TitleBatch();
+        string error;
+        if(!written || !store.open(titlesPath, error)){
+            cerr << "Error: could not write " << titlesPath << endl;
             return false;
         }
+        return true;
+    }
 
-        string line;
-        long long count = 0;
+    // Answers from the engine chosen at load time.
+    vector<Suggestion> getSuggestion(const QueryPath& query, int limit = 10) const{
+        if(query.text.empty()) return {};
+        return useFst ? suggest(fstPrefixes, fstWords, query, limit) : suggest(prefixes, words, query, limit);
+    }
 
-        while(getline(infile, line)){
-            try{
-                auto j = json::parse(line);
-                int pageId = j["id"];
-                double len;
-                auto it = pagerank_scores.find(pageId);
-                if(it == pagerank_scores.end()){
-                    len = 0;
-                }
-                else{
-                    len = it->second;
-                }
-                string title = j["title"];
+    vector<Suggestion> getSuggestion(const string& prefix, int limit = 10) const{
+        QueryPath query;
+        type(query, prefix);
+        return getSuggestion(query, limit);
+    }
 
-                this->insert(title, len, pageId);
-                count++;
+    void type(QueryPath& query, const string& text) const{
+        if(useFst) step(fstPrefixes, fstWords, query, text);
+        else step(prefixes, words, query, text);
+    }
 
+    // Drops the last count bytes of the query.
+    void erase(QueryPath& query, size_t count) const{
+        size_t keep = query.text.size() - min(count, query.text.size());
+        query.text.resize(keep);
+        query.titleNodes.resize(keep);
+        query.wordNodes.resize(keep);
+    }
 
-            }
-            catch (const json::parse_error& e) {
-                cerr << "Error: JSON Parse Error on line " << count + 1 << ": " << e.what() << endl;
-                continue;
-            }
-            catch (const json::type_error& e) {
-                // This catches errors like trying to read j["id"] as an int when it's a string.
-                cerr << "Error: JSON Type Error on line " << count + 1 << ": " << e.what() << endl;
-                continue;
-            }
-            catch(exception& e){
-                cerr << "Error: " << e.what() << endl;
-                continue;
-            }
+    // Makes text the query, keeping the steps it shares with the old one.
+    void retype(QueryPath& query, const string& text) const{
+        size_t same = 0;
+        while(same < query.text.size() && same < text.size() && query.text[same] == static_cast<char>(tolower(text[same]))) same++;
+        erase(query, query.text.size() - same);
+        type(query, text.substr(same));
+    }
+
+    bool saveToDisk(const string& filename){
+        TrieFileHeader header = {};
+        memcpy(header.magic, TRIE_MAGIC, sizeof(TRIE_MAGIC));
+        header.version = TRIE_VERSION;
+        header.headerSize = sizeof(TrieFileHeader);
+        header.topK = TOP_K;
+        header.titleStoreChecksum = store.checksum();
+        uint64_t pos = sizeof(TrieFileHeader);
+        header.prefixes = prefixes.section(pos);
+        header.words = words.section(pos);
+        header.checksum = fnv1a(&header, offsetof(TrieFileHeader, checksum));
+
+        ofstream outfile(filename, ios::binary);
+        if(!outfile.is_open()) return false;
+        auto writeAt = [&outfile](uint64_t pos, const void* data, uint64_t len){
+            static const char zeros[64] = {};
+            outfile.write(zeros, pos - static_cast<uint64_t>(outfile.tellp()));
+            outfile.write(static_cast<const char*>(data), len);
+        };
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for(const auto& [index, s] : {make_pair(&prefixes, header.prefixes), make_pair(&words, header.words)}){
+            writeAt(s.nodesPos, index->nodes, s.numNodes * sizeof(TrieNode));
+            writeAt(s.labelsPos, index->labels, s.numNodes);
+            writeAt(s.topsPos, index->tops, s.numTops * sizeof(uint32_t));
+            writeAt(s.titlesPos, index->titles, s.numTitles * sizeof(TrieTitle));
         }
+        outfile.close();
+        return !outfile.fail();
+    }
 
-        infile.close();
-        return true;
+    // Maps trie2.bin and its title store and points both tries into them;
+    // nothing is copied.
+    bool loadFromDisk(const string& filename, const string& titlesPath){
+        string error;
+        if(!store.open(titlesPath, error)){
+            cerr << "Error: " << error << endl;
+            return false;
+        }
+        if(!file.open(filename)) return false;
+
+        TrieFileHeader header = {};
+        if(file.size() >= sizeof(header)) memcpy(&header, file.data(), sizeof(header));
+        bool valid = memcmp(header.magic, TRIE_MAGIC, sizeof(TRIE_MAGIC)) == 0
+                  && header.version == TRIE_VERSION
+                  && header.headerSize == sizeof(TrieFileHeader)
+                  && header.topK == TOP_K
+                  && header.checksum == fnv1a(&header, offsetof(TrieFileHeader, checksum));
+        if(!valid){
+            cerr << "Error: " << filename << " is not a version " << TRIE_VERSION << " trie, rebuild it with ./autoCompleteTrie build" << endl;
+            file.close();
+            return false;
+        }
+        if(!prefixes.attach(file.data(), file.size(), header.prefixes) || !words.attach(file.data(), file.size(), header.words)){
+            cerr << "Error: " << filename << " is truncated or corrupt" << endl;
+            file.close();
+            return false;
+        }
+        if(header.titleStoreChecksum != store.checksum()){
+            cerr << "Error: " << filename << " was built with a different " << titlesPath << ", rebuild both with ./autoCompleteTrie build" << endl;
+            file.close();
+            return false;
+        }
+        return prefixes.nodes[0].numChildren > 0;
     }
 
-};
+    bool saveFstToDisk(const string& filename){
+        FstFileHeader header = {};
+        memcpy(header.magic, FST_MAGIC, sizeof(FST_MAGIC));
+        header.version = FST_VERSION;
+        header.headerSize = sizeof(FstFileHeader);
+        header.titleStoreChecksum = store.checksum();
+        header.numTitles = prefixes.numTitles;
+        header.titlesPos = trie_align(sizeof(FstFileHeader));
+        uint64_t pos = header.titlesPos + header.numTitles * sizeof(TrieTitle);
+        header.prefixes = fstPrefixes.section(pos);
+        header.words = fstWords.section(pos);
+        header.checksum = fnv1a(&header, offsetof(FstFileHeader, checksum));
 
-void load_pagerank_scores(){
-    ifstream infile(PAGERANK_SCORES_PATH);
-    if(!infile.is_open()){
-        cerr << "Error: Pagerank file could not be opened";
-        exit(1);
+        ofstream outfile(filename, ios::binary);
+        if(!outfile.is_open()) return false;
+        auto writeAt = [&outfile](uint64_t pos, const void* data, uint64_t len){
+            static const char zeros[64] = {};
+            outfile.write(zeros, pos - static_cast<uint64_t>(outfile.tellp()));
+            outfile.write(static_cast<const char*>(data), len);
+        };
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeAt(header.titlesPos, prefixes.titles, header.numTitles * sizeof(TrieTitle));
+        fstPrefixes.write(header.prefixes, writeAt);
+        fstWords.write(header.words, writeAt);
+        outfile.close();
+        return !outfile.fail();
+    }
+
+    // Maps suggest.fst and its title store and answers from the FSTs from
+    // then on; trie2.bin is not read.
+    bool loadFstFromDisk(const string& filename, const string& titlesPath){
+        string error;
+        if(!store.open(titlesPath, error)){
+            cerr << "Error: " << error << endl;
+            return false;
+        }
+        if(!file.open(filename)) return false;
+
+        FstFileHeader header = {};
+        if(file.size() >= sizeof(header)) memcpy(&header, file.data(), sizeof(header));
+        bool valid = memcmp(header.magic, FST_MAGIC, sizeof(FST_MAGIC)) == 0
+                  && header.version == FST_VERSION
+                  && header.headerSize == sizeof(FstFileHeader)
+                  && header.checksum == fnv1a(&header, offsetof(FstFileHeader, checksum));
+        if(!valid){
+            cerr << "Error: " << filename << " is not a version " << FST_VERSION << " FST, rebuild it with ./autoCompleteTrie build" << endl;
+            file.close();
+            return false;
+        }
+        const TrieTitle* titles = reinterpret_cast<const TrieTitle*>(file.data() + header.titlesPos);
+        if(header.titlesPos + header.numTitles * sizeof(TrieTitle) > file.size()
+           || !fstPrefixes.attach(file.data(), file.size(), header.prefixes, titles)
+           || !fstWords.attach(file.data(), file.size(), header.words, titles)){
+            cerr << "Error: " << filename << " is truncated or corrupt" << endl;
+            file.close();
+            return false;
+        }
+        if(header.titleStoreChecksum != store.checksum()){
+            cerr << "Error: " << filename << " was built with a different " << titlesPath << ", rebuild both with ./autoCompleteTrie build" << endl;
+            file.close();
+            return false;
+        }
+        useFst = true;
+        return fstPrefixes.numKeys > 0;
     }
 
+    // doc_info.jsonl is mapped and cut at line breaks into a few parts per
+    // thread, which are parsed concurrently and appended in file order, so a
+    // repeated title resolves as in a sequential read.
+    bool buildFromJSON(const string& filename, ThreadPool& pool){
+        MappedFile docinfo;
+        if(!docinfo.open(filename)){
+            cerr << "Error: JSONL File not opening";
+            return false;
+        }
+        docinfo.willNeed();
+
+        struct Part{
+            TitleBatch titles;
+            size_t lines = 0;
+            vector<pair<size_t, string>> errors;    // line within the part, message
+        };
+        unsigned numParts = pool.size() * 4;
+        vector<Part> parts(numParts);
+        const char* data = docinfo.data();
+        const char* data_end = data + docinfo.size();
+        vector<const char*> bounds(numParts + 1, data_end);
+        bounds[0] = data;
+        for(unsigned p = 1; p < numParts; p++){
+            const char* at = max(bounds[p - 1], data + docinfo.size() / numParts * p);
+            const char* nl = static_cast<const char*>(memchr(at, '\n', data_end - at));
+            bounds[p] = nl ? nl + 1 : data_end;
+        }
 
-    pagerank_scores.reserve(7084107);
-    string line;
+        pool.parallelFor(numParts, [&](unsigned p){
+            Part& part = parts[p];
+            string title;
+            for(const char* line = bounds[p]; line < bounds[p + 1];){
+                const char* nl = static_cast<const char*>(memchr(line, '\n', bounds[p + 1] - line));
+                const char* line_end = nl ? nl : bounds[p + 1];
+                string_view text(line, line_end - line);
+                line = line_end + 1;
+                part.lines++;
+                if(!text.empty() && text.back() == '\r') text.remove_suffix(1);
+                if(text.empty()) continue;
+
+                int pageId;
+                uint32_t docLength;
+                if(!parse_doc_line(text, pageId, title, docLength)){
+                    // Unusual lines (reordered or nested fields) go through the full parser.
+                    try{
+                        auto j = json::parse(text.begin(), text.end());
+                        pageId = j["id"];
+                        title = j["title"];
+                        docLength = j.value("len", 0);
+                    }
+                    catch(exception& e){
+                        part.errors.push_back({part.lines, e.what()});
+                        continue;
+                    }
+                }
+                part.titles.add(title, pagerank_scores.score(pageId), pageId, docLength);
+            }
+        });
 
-    while(getline(infile, line)){
-        size_t comma_pos = line.find(',');
-        if(comma_pos == string::npos) continue;
-        try{
-            int doc_id = stoi(line.substr(0, comma_pos));
-            double score = stod(line.substr(comma_pos+1));
+        size_t lines = 0;
+        for(Part& part : parts){
+            for(const auto& [line, message] : part.errors) cerr << "Error: JSON Error on line " << lines + line << ": " << message << endl;
+            lines += part.lines;
+            pending.append(part.titles);
+            part = Part();
+        }
+        return true;
+    }
 
-            pagerank_scores[doc_id] = score;
+};
 
+// Session protocol, for a front end that sends a line per keystroke:
+//   #<id> +<text>    type text at the end of session id's query
+//   #<id> -<n>       delete the last n bytes (1 if n is left out)
+//   #<id> =<text>    make text the query; only the bytes that differ from
+//                    the previous one are stepped
+//   #<id> .          end the session
+// Every command but "." is answered like a plain query line. A new id
+// starts with an empty query. Lines that do not parse as a command are
+// plain queries.
+class SessionTable{
+public:
+    // Limits on the number of open sessions and the length of each query,
+    // for front ends that cannot be trusted; none by default.
+    explicit SessionTable(size_t maxSessions = SIZE_MAX, size_t maxQuery = SIZE_MAX)
+        : maxSessions(maxSessions), maxQuery(maxQuery){}
+
+    // Applies a session command and points query at the session, or sets it
+    // to nullptr when the session ended or the command was refused; error
+    // then says why. False if line is not a command.
+    bool apply(const Trie& trie, const string& line, QueryPath*& query, string& error){
+        size_t space = line.find(' ');
+        if(line.size() < 4 || line[0] != '#' || space == string::npos || space < 2 || space + 1 >= line.size()) return false;
+        for(size_t i = 1; i < space; i++){
+            if(!isdigit(static_cast<unsigned char>(line[i]))) return false;
         }
-        catch(exception &e){
-            cout << "Error: " << e.what() << endl;
-            continue;
+        string id = line.substr(1, space - 1);
+        char op = line[space + 1];
+        string arg = line.substr(space + 2);
+        bool isDigits = all_of(arg.begin(), arg.end(), [](unsigned char c){ return isdigit(c); });
+        if(!(op == '+' || op == '=' || (op == '-' && arg.size() <= 6 && isDigits) || (op == '.' && arg.empty()))) return false;
+        query = nullptr;
+        error.clear();
+
+        if(op == '.'){
+            sessions.erase(id);
+            return true;
+        }
+        auto it = sessions.find(id);
+        if(it == sessions.end() && sessions.size() >= maxSessions){
+            error = "too many sessions";
+            return true;
+        }
+        size_t length = it == sessions.end() ? 0 : it->second.text.size();
+        if((op == '+' && length + arg.size() > maxQuery) || (op == '=' && arg.size() > maxQuery)){
+            error = "query too long";
+            return true;
         }
+
+        query = &sessions[id];
+        if(op == '-') trie.erase(*query, arg.empty() ? 1 : stoul(arg));
+        else if(op == '+') trie.type(*query, arg);
+        else trie.retype(*query, arg);
+        return true;
     }
 
-    return;
+private:
+    unordered_map<string, QueryPath> sessions;
+    size_t maxSessions;
+    size_t maxQuery;
+};
 
+void load_pagerank_scores(){
+    string error;
+    if(!pagerank_scores.open(PAGERANK_SCORES_PATH, error)){
+        cerr << "Error: Pagerank file could not be opened: " << error << endl;
+        exit(1);
+    }
 }
 
 
 int main(int argc, char* argv[]){
 
     Trie trie;
+    SessionTable sessions;
     string mode = (argc > 1) ? argv[1] : "run";
+    // --engine trie|fst picks the index queries are answered from; build writes both.
+    string engine = "trie";
+    for(int i = 1; i + 1 < argc; i++){
+        if(string(argv[i]) == "--engine") engine = argv[i + 1];
+    }
+    if(engine != "trie" && engine != "fst"){
+        cerr << "Error: unknown engine " << engine << ", use trie or fst" << endl;
+        return 1;
+    }
 
 
     if(mode == "build"){
         load_pagerank_scores();
-        if(trie.buildFromJSON(DOC_INFO_PATH)){
-            trie.saveToDisk(TRIE_BINARY_PATH);
+        ThreadPool pool;
+        if(trie.buildFromJSON(DOC_INFO_PATH, pool)){
+            if(!trie.build(TITLE_STORE_PATH, pool)) return 1;
+            if(!trie.saveToDisk(TRIE_BINARY_PATH)){
+                cerr << "Error: could not write " << TRIE_BINARY_PATH << endl;
+                return 1;
+            }
+            if(!trie.saveFstToDisk(FST_BINARY_PATH)){
+                cerr << "Error: could not write " << FST_BINARY_PATH << endl;
+                return 1;
+            }
         }
         return 0;
     }
 
-    bool loaded = trie.loadFromDisk(TRIE_BINARY_PATH);
+    bool loaded = engine == "fst" ? trie.loadFstFromDisk(FST_BINARY_PATH, TITLE_STORE_PATH)
+                                  : trie.loadFromDisk(TRIE_BINARY_PATH, TITLE_STORE_PATH);
     
     if(!loaded){
         cerr << "Error: could not load binary file" << endl;
@@ -297,7 +1364,12 @@ int main(int argc, char* argv[]){
         if(!getline(cin, input) || input == "exit") break;
         if(input.empty()) continue;
 
-        vector<Suggestion> sg = trie.getSuggestion(input);
+        vector<Suggestion> sg;
+        QueryPath* session = nullptr;
+        string error;
+        if(!sessions.apply(trie, input, session, error)) sg = trie.getSuggestion(input);
+        else if(session != nullptr) sg = trie.getSuggestion(*session);
+        else continue;
 
         if(sg.empty()){
             cout << "No suggestions found" << endl;
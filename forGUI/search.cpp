@@ -9,24 +9,33 @@
 #include <iomanip>
 #include <chrono>
 #include <unordered_set>
-#include "json.hpp"
 #include "check_stem.hpp"
-
-using json = nlohmann::json;
+#include "index_format.hpp"
+#include "score_file.hpp"
+#include "title_store.hpp"
 
 const string INDEX_FILE = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\BinsAndTxtx\\index.bin";
-const string OFFSET_FILE = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\BinsAndTxtx\\offset.txt";
-const string DOC_INFO_FILE=  "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\data_files\\doc_info.jsonl";
+const string DICTIONARY_FILE = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\BinsAndTxtx\\dictionary.bin";
+const string TITLE_STORE_FILE = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\titles.bin";
 const string PYTHON_STEMMER_SCRIPT = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\stemmer_bridge.py";
 const string STOPWORD_FILE = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\stopwords.txt";
-const string PAGERANK_SCORES_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\pagerank_scores.csv";
+const string PAGERANK_SCORES_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\pagerank_scores.bin";
+const string TOPIC_SCORES_PATH = "C:\\Users\\Arnav\\Desktop\\Programming\\WikiEngine\\pagerank_topics.bin";
 const float alpha = 0.2;
 
-unordered_map<int, pair<string, int>> doc_details;
+// Titles and document lengths, written by ./autoCompleteTrie build and mapped
+// rather than parsed from doc_info.jsonl.
+TitleStore doc_titles;
 double avg_doc_length = 0.0;
+IndexHeader index_header;
 
 unordered_set<string> stopwords;
-unordered_map<int, double> pagerank_scores;
+PageRankScores pagerank_scores;
+// Personalised PageRank vectors from pageRank --topics, one column per topic.
+// A query starting with @name ranks with that column instead of the global
+// scores; the file stays mapped, so switching is free.
+ScoreFile topic_scores;
+bool topics_loaded = false;
 
 struct Posting{
     int doc_id;
@@ -41,45 +50,16 @@ struct SearchResult{
 
 
 void load_titles(){
-    ifstream infile(DOC_INFO_FILE);
-    if(!infile.is_open()){
-        cerr << "Error: Could not open doc file";
-        return;
-    }
-
-    doc_details.reserve(7084107);
-
-    string line;
-    long long count = 0;
-    long long total_corpus_length = 0;
-
-    while(getline(infile, line)){
-        try{
-            auto j = json::parse(line);
-            int doc_id = j["id"];
-            string doc_title = j["title"];
-            int doc_length = j["len"];
-
-            doc_details[doc_id] = {doc_title, doc_length};
-            total_corpus_length += doc_length;
-
-            count++;
-        }
-        catch(exception &e){
-            cerr << "Error: " << e.what() << endl;
-            return;
-        }
-    }
-    infile.close();
-    if(doc_details.size() > 0){
-        avg_doc_length = (double)total_corpus_length / count; 
+    string error;
+    if(!doc_titles.open(TITLE_STORE_FILE, error)){
+        cerr << "Error: Title store could not be opened: " << error << endl;
+        exit(1);
     }
-    return;
 }
 
 string get_title(int doc_id){
-    auto it = doc_details.find(doc_id);
-    if(it != doc_details.end()) return it->second.first;
+    string title;
+    if(doc_titles.titleOf(doc_id, title)) return title;
     return "Unknown Title";
 }
 
@@ -98,67 +78,58 @@ void load_stopwords(){
 }
 
 void load_pagerank_scores(){
-    ifstream infile(PAGERANK_SCORES_PATH);
-    if(!infile.is_open()){
-        cerr << "Error: Pagerank file could not be opened";
+    string error;
+    if(!pagerank_scores.open(PAGERANK_SCORES_PATH, error)){
+        cerr << "Error: Pagerank file could not be opened: " << error << endl;
         exit(1);
     }
+}
 
-    pagerank_scores.reserve(7084107);
-    string line;
-    long long count = 0;
-
-    while(getline(infile, line)){
-        size_t comma_pos = line.find(',');
-        if(comma_pos == string::npos) continue;
-        try{
-            int doc_id = stoi(line.substr(0, comma_pos));
-            double score = stod(line.substr(comma_pos+1));
 
-            pagerank_scores[doc_id] = score;
-        }
-        catch(exception &e){
-            cout << "Error: " << e.what() << endl;
-            continue;
-        }
-    }
-    return;
+void load_topic_vectors(){
+    string error;
+    topics_loaded = topic_scores.open(TOPIC_SCORES_PATH, error);
 }
 
+// Splits a leading "@name " off the query and returns the topic column, or -1
+// for the global pagerank.
+int take_topic(string& query){
+    if(query.empty() || query[0] != '@') return -1;
+    size_t space = query.find(' ');
+    string name = query.substr(1, space == string::npos ? string::npos : space - 1);
+    query = (space == string::npos) ? "" : query.substr(space + 1);
 
-int main(){
-
+    return topics_loaded ? topic_scores.findColumn(name) : -1;
+}
 
-    load_titles();
-    load_stopwords();    
-    load_pagerank_scores();
+int main(){
 
-    unordered_map<string, long long> offsets;
-    ifstream offset_file(OFFSET_FILE);
 
-    if(!offset_file.is_open()){
-        cerr << "Erorr: Output file could not open";
+    ifstream bin_file(INDEX_FILE, ios::binary);
+    
+    if(!bin_file.is_open()){
+        cerr << "Error: Could not open bin file";
         return 1;
     }
 
-    string term;
-    long long pos;
-
-    while(offset_file >> term >> pos){
-        offsets[term] = pos;
+    string header_error;
+    if(!read_index_header(bin_file, index_header, header_error)){
+        cerr << "Error: Invalid index header: " << header_error << endl;
+        return 1;
     }
+    avg_doc_length = index_header.avgDocLength;
+    const double total_docs = static_cast<double>(index_header.numDocs);
 
-    offset_file.close();
+    load_titles();
+    load_stopwords();    
+    load_pagerank_scores();
+    load_topic_vectors();
 
-    ifstream bin_file(INDEX_FILE, ios::binary);
-    
-    if(!bin_file.is_open()){
-        cerr << "Error: Could not open bin file";
+    Dictionary dictionary;
+    if(!dictionary.load(DICTIONARY_FILE)){
+        cerr << "Error: Dictionary file could not be loaded";
         return 1;
     }
-
-    int total_docs;
-    bin_file.read(reinterpret_cast<char*>(&total_docs), sizeof(total_docs));
     
     PythonStemmer pstemmer(PYTHON_STEMMER_SCRIPT);
 
@@ -173,6 +144,7 @@ int main(){
     while(true){
         if(!getline(cin, input_line) || input_line == "exit") break;
 
+        int topic = take_topic(input_line);
         if(input_line.empty()) continue;
 
         auto start_time = chrono::high_resolution_clock::now();
@@ -193,11 +165,11 @@ int main(){
         unordered_map<int, double> doc_scores;
 
         for(const string& term : search_term){
-            if(offsets.find(term) == offsets.end()){
+            long long byte_offset;
+            if(!dictionary.find(term, byte_offset)){
                 continue;
             } 
 
-            long long byte_offset = offsets[term];
             if(bin_file.fail() || bin_file.bad()) {
                 cerr << "  WARNING: Stream in bad state before seek!" << endl;
                 bin_file.clear();
@@ -222,7 +194,7 @@ int main(){
             }
 
 
-            if(doc_freq <= 0 || doc_freq > 7084107) {
+            if(doc_freq <= 0 || (uint64_t)doc_freq > index_header.numDocs) {
                 cerr << "  ERROR: Invalid doc_freq value!" << endl;
                 continue;
             }
@@ -241,9 +213,9 @@ int main(){
 
             for(const auto& p : postings){
                 int doc_len = int(avg_doc_length);
-                auto it = doc_details.find(p.doc_id);
-                if(it != doc_details.end()){
-                    doc_len = it->second.second;
+                int64_t stored_len = doc_titles.lengthOf(p.doc_id);
+                if(stored_len >= 0){
+                    doc_len = int(stored_len);
                 }
 
                 float raw_freq = p.tf_score * doc_len;
@@ -251,7 +223,7 @@ int main(){
                 double numerator = raw_freq * (k1+1);
                 double denominator = raw_freq + k1 * (1 - b + b * ((double) doc_len / avg_doc_length));
                 double bm25_score = idf * (numerator / denominator);
-                double pgscore = pagerank_scores[p.doc_id];
+                double pgscore = (topic >= 0) ? topic_scores.score(topic, p.doc_id) : pagerank_scores.score(p.doc_id);
                 double pgnorm = log(1.0 + pgscore * pagerank_scores.size());
 
                 doc_scores[p.doc_id] += bm25_score + alpha * pgnorm;
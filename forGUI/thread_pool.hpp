@@ -0,0 +1,118 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of worker threads fed from one task queue.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned numThreads = thread::hardware_concurrency()) {
+        if (numThreads == 0) numThreads = 1;
+        for (unsigned i = 0; i < numThreads; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    unsigned size() const { return workers.size(); }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // Runs fn(0) .. fn(parts - 1) on the pool and returns once all have finished.
+    // Which thread runs a part is unspecified, so callers that need reproducible
+    // results keep one output slot per part and combine them in part order.
+    void parallelFor(unsigned parts, const function<void(unsigned)>& fn) {
+        mutex doneMtx;
+        condition_variable doneCv;
+        unsigned remaining = parts;
+
+        for (unsigned p = 0; p < parts; p++) {
+            submit([&, p] {
+                fn(p);
+                lock_guard<mutex> lock(doneMtx);
+                if (--remaining == 0) doneCv.notify_one();
+            });
+        }
+
+        unique_lock<mutex> lock(doneMtx);
+        doneCv.wait(lock, [&] { return remaining == 0; });
+    }
+
+private:
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex mtx;
+    condition_variable wake;
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mtx);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// Stable sort on the pool: equal runs are sorted concurrently, then merged
+// pairwise, the merges of one round also running concurrently.
+template <typename T, typename Less>
+void parallelStableSort(ThreadPool& pool, vector<T>& items, Less less) {
+    size_t parts = 1;
+    while (parts < pool.size() && items.size() >= parts * 2 * 4096) parts *= 2;
+    if (parts == 1) {
+        stable_sort(items.begin(), items.end(), less);
+        return;
+    }
+
+    vector<size_t> bounds(parts + 1);
+    for (size_t p = 0; p <= parts; p++) bounds[p] = items.size() * p / parts;
+    pool.parallelFor(parts, [&](unsigned p) {
+        stable_sort(items.begin() + bounds[p], items.begin() + bounds[p + 1], less);
+    });
+
+    vector<T> merged(items.size());
+    for (size_t width = 1; width < parts; width *= 2) {
+        pool.parallelFor(parts / (2 * width), [&](unsigned m) {
+            size_t lo = bounds[2 * m * width], mid = bounds[(2 * m + 1) * width], hi = bounds[(2 * m + 2) * width];
+            merge(make_move_iterator(items.begin() + lo), make_move_iterator(items.begin() + mid),
+                  make_move_iterator(items.begin() + mid), make_move_iterator(items.begin() + hi),
+                  merged.begin() + lo, less);
+        });
+        items.swap(merged);
+    }
+}
+
+#endif // THREAD_POOL_HPP
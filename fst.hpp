@@ -0,0 +1,212 @@
+#ifndef FST_HPP
+#define FST_HPP
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "index_format.hpp"
+
+using namespace std;
+
+// Minimal acyclic finite-state transducer over sorted byte strings. Every
+// key carries a weight (higher is better). Each path's arc outputs add up
+// to the key's rank in sorted order. Weights are pushed toward the start:
+// a state's arcs and final flag store how far each continuation falls short
+// of the best key below the state.
+// Walking a prefix and subtracting the penalties therefore gives the
+// weight of the best key under that prefix. A best-first search needs
+// nothing more.
+//
+// States are identified by byte offset. Equal states are stored once, so
+// common suffixes such as " (film)" are shared between titles. Each state is
+// encoded as:
+//   varint  numArcs << 1 | isFinal
+//   varint  finalPenalty                  if isFinal
+//   uint8   labels[numArcs]               ascending
+//   per arc: varint output, varint penalty, varint target
+// An arc's output counts the keys ordered before it under the state, the
+// state's own key included. Offset 0 holds no state, so callers can use it
+// for "none".
+
+struct FstArc {
+    uint32_t output;
+    int32_t penalty;
+    uint32_t target;
+};
+
+class FstBuilder {
+public:
+    FstBuilder() {
+        bytes.push_back('\0');
+        table.assign(1024, 0);
+        open.resize(1);
+    }
+
+    // Keys must arrive in strictly ascending byte order.
+    void add(string_view key, int32_t weight) {
+        size_t shared = 0;
+        while (shared < previous.size() && shared < key.size() && previous[shared] == key[shared]) shared++;
+        finishDownTo(shared);
+        for (; depth < key.size(); depth++) {
+            if (open.size() == depth + 1) open.emplace_back();
+            OpenState& next = open[depth + 1];
+            next.label = key[depth];
+            next.isFinal = false;
+            next.arcs.clear();
+        }
+        open[depth].isFinal = true;
+        open[depth].weight = weight;
+        previous.assign(key.data(), key.size());
+        numKeys++;
+    }
+
+    // Writes out the states still open, the root last.
+    void finish() {
+        finishDownTo(0);
+        Built root = freeze(open[0]);
+        rootState = root.target;
+        rootWeight = root.weight;
+    }
+
+    const string& data() const { return bytes; }
+    uint32_t root() const { return rootState; }
+    int32_t bestWeight() const { return rootWeight; }
+    uint64_t size() const { return numKeys; }
+    uint64_t states() const { return numStates; }
+
+private:
+    struct Built {
+        unsigned char label;
+        uint32_t target;
+        uint32_t count;         // keys below
+        int32_t weight;         // best key below
+    };
+    struct OpenState {
+        unsigned char label = 0;
+        bool isFinal = false;
+        int32_t weight = 0;
+        vector<Built> arcs;
+    };
+
+    string bytes;
+    string encoded;
+    string previous;
+    vector<OpenState> open;     // open[d] is the state at depth d of the previous key
+    size_t depth = 0;
+    vector<uint64_t> table;     // hash << 32 | offset, 0 when empty
+    uint64_t numKeys = 0;
+    uint64_t numStates = 0;
+    uint32_t rootState = 0;
+    int32_t rootWeight = 0;
+
+    void finishDownTo(size_t keep) {
+        for (; depth > keep; depth--) open[depth - 1].arcs.push_back(freeze(open[depth]));
+    }
+
+    Built freeze(const OpenState& s) {
+        int32_t best = s.isFinal ? s.weight : (s.arcs.empty() ? 0 : INT32_MIN);
+        for (const Built& a : s.arcs) best = max(best, a.weight);
+
+        encoded.clear();
+        write_varint(encoded, s.arcs.size() << 1 | s.isFinal);
+        if (s.isFinal) write_varint(encoded, best - s.weight);
+        for (const Built& a : s.arcs) encoded.push_back(a.label);
+        uint32_t count = s.isFinal;
+        for (const Built& a : s.arcs) {
+            write_varint(encoded, count);
+            write_varint(encoded, best - a.weight);
+            write_varint(encoded, a.target);
+            count += a.count;
+        }
+        return {s.label, intern(), count, best};
+    }
+
+    // Offset of a state encoded like `encoded`, appending it if it is new.
+    // Encodings are self-delimiting, so matching bytes mean the same state.
+    uint32_t intern() {
+        uint32_t hash = static_cast<uint32_t>(fnv1a(encoded.data(), encoded.size()));
+        size_t mask = table.size() - 1;
+        size_t slot = hash & mask;
+        for (; table[slot] != 0; slot = (slot + 1) & mask) {
+            uint32_t offset = static_cast<uint32_t>(table[slot]);
+            if (table[slot] >> 32 == hash && offset + encoded.size() <= bytes.size()
+                && memcmp(bytes.data() + offset, encoded.data(), encoded.size()) == 0) return offset;
+        }
+        uint32_t offset = bytes.size();
+        bytes += encoded;
+        table[slot] = static_cast<uint64_t>(hash) << 32 | offset;
+        if (++numStates * 2 > table.size()) grow();
+        return offset;
+    }
+
+    void grow() {
+        vector<uint64_t> old(table.size() * 2, 0);
+        old.swap(table);
+        size_t mask = table.size() - 1;
+        for (uint64_t entry : old) {
+            if (entry == 0) continue;
+            size_t slot = (entry >> 32) & mask;
+            while (table[slot] != 0) slot = (slot + 1) & mask;
+            table[slot] = entry;
+        }
+    }
+};
+
+// Read-only view of the bytes written by FstBuilder.
+class Fst {
+public:
+    void attach(const char* bytes) { data = bytes; }
+
+    // Whether a key ends at state s, and how far below the state's best it is.
+    bool final(uint32_t s, int32_t& penalty) const {
+        const char* p = data + s;
+        if (!(read_varint(p) & 1)) return false;
+        penalty = static_cast<int32_t>(read_varint(p));
+        return true;
+    }
+
+    // The arc labelled label out of s; false if there is none.
+    bool child(uint32_t s, unsigned char label, FstArc& arc) const {
+        const char* p = data + s;
+        uint64_t head = read_varint(p);
+        size_t numArcs = head >> 1;
+        if (head & 1) read_varint(p);
+        const char* hit = static_cast<const char*>(memchr(p, label, numArcs));
+        if (hit == nullptr) return false;
+        size_t index = hit - p;
+        p += numArcs;
+        for (size_t i = 0; i < index * 3; i++) {
+            while (*p++ & 0x80) {}
+        }
+        arc = readArc(p);
+        return true;
+    }
+
+    // Calls fn(label, arc) for every arc out of s, in label order.
+    template <typename F>
+    void forEachArc(uint32_t s, F fn) const {
+        const char* p = data + s;
+        uint64_t head = read_varint(p);
+        size_t numArcs = head >> 1;
+        if (head & 1) read_varint(p);
+        const char* labels = p;
+        p += numArcs;
+        for (size_t i = 0; i < numArcs; i++) fn(static_cast<unsigned char>(labels[i]), readArc(p));
+    }
+
+private:
+    const char* data = nullptr;
+
+    static FstArc readArc(const char*& p) {
+        FstArc arc;
+        arc.output = static_cast<uint32_t>(read_varint(p));
+        arc.penalty = static_cast<int32_t>(read_varint(p));
+        arc.target = static_cast<uint32_t>(read_varint(p));
+        return arc;
+    }
+};
+
+#endif // FST_HPP
@@ -3,16 +3,13 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include "index_format.hpp"
 
 using namespace std;
 
 // --- CONFIGURATION ---
 const string INDEX_FILE = "BinsAndTxtx\\index.bin";
-const string OFFSET_FILE = "BinsAndTxtx\\offset.txt";
-
-// Adjust this to your approximate total docs to catch garbage integers
-const long long MAX_VALID_DOC_ID = 81491764; 
-const long long MAX_DOC_FREQ = 7084107;
+const string DICTIONARY_FILE = "BinsAndTxtx\\dictionary.bin";
 
 struct Posting {
     int doc_id;
@@ -26,9 +23,9 @@ int main() {
 
     cout << "--- Starting Index Validation ---" << endl;
 
-    ifstream offset_file(OFFSET_FILE);
-    if (!offset_file.is_open()) {
-        cerr << "Error: Could not open offsets file." << endl;
+    Dictionary dictionary;
+    if (!dictionary.load(DICTIONARY_FILE)) {
+        cerr << "Error: Could not load dictionary file." << endl;
         return 1;
     }
 
@@ -38,25 +35,46 @@ int main() {
         return 1;
     }
 
-    // 1. Verify Header
-    int total_docs;
-    bin_file.read(reinterpret_cast<char*>(&total_docs), sizeof(total_docs));
-    
-    cout << "Header Check: Total Docs = " << total_docs << endl;
-    if (total_docs <= 0 || total_docs > MAX_DOC_FREQ) {
-        cerr << "CRITICAL FAIL: Header contains garbage value!" << endl;
+    // 1. Verify Header (magic, version, checksum)
+    IndexHeader header;
+    string header_error;
+    if (!read_index_header(bin_file, header, header_error)) {
+        cerr << "CRITICAL FAIL: " << header_error << endl;
+        return 1;
+    }
+
+    cout << "Header Check: Total Docs = " << header.numDocs << ", Max DocID = " << header.maxDocId
+         << ", Terms = " << header.numTerms << ", Postings = " << header.numPostings << endl;
+    if (header.numDocs == 0 || header.maxDocId < 0) {
+        cerr << "CRITICAL FAIL: Header describes an empty corpus!" << endl;
         return 1;
     }
+    if (header.numTerms != dictionary.size()) {
+        cerr << "CRITICAL FAIL: Header has " << header.numTerms << " terms, dictionary has " << dictionary.size() << endl;
+        return 1;
+    }
+
+    // Limits used to catch garbage integers come from the header
+    const long long MAX_VALID_DOC_ID = header.maxDocId;
+    const long long MAX_DOC_FREQ = header.maxDocFreq;
 
-    string term;
-    long long offset;
     long long terms_checked = 0;
     long long errors_found = 0;
+    unsigned long long postings_seen = 0;
+    string previous_term;
 
     cout << "Scanning terms..." << endl;
 
-    while (offset_file >> term >> offset) {
+    dictionary.forEach([&](string_view term_view, uint64_t offset) {
+        string term(term_view);
         terms_checked++;
+
+        // Front coding and prefix search rely on strictly increasing terms
+        if (terms_checked > 1 && term <= previous_term) {
+            cerr << "[FAIL] Dictionary out of order at term: '" << term << "' after '" << previous_term << "'" << endl;
+            errors_found++;
+        }
+        previous_term = term;
         
         // A. Seek to Data
         bin_file.seekg(offset);
@@ -64,7 +82,7 @@ int main() {
              cerr << "[FAIL] Seek error for term: " << term << " at offset " << offset << endl;
              errors_found++;
              bin_file.clear(); // Reset error state
-             continue;
+             return;
         }
 
         // B. Read Document Frequency
@@ -74,10 +92,13 @@ int main() {
         if (bin_file.fail() || doc_freq < 0 || doc_freq > MAX_DOC_FREQ) {
             cerr << "[FAIL] Corrupt DocFreq for term: '" << term << "' (Offset: " << offset << ") -> Value: " << doc_freq << endl;
             errors_found++;
+            bin_file.clear();
             // We can't verify postings if count is garbage, so skip
-            continue; 
+            return; 
         }
 
+        postings_seen += doc_freq;
+
         // C. Read Postings (Sanity Check IDs)
         // We don't need to store them, just read and verify
         // To save RAM, we read one by one instead of allocating a huge vector
@@ -96,11 +117,15 @@ int main() {
         if (terms_checked % 100000 == 0) {
             cout << "Checked " << terms_checked << " terms... (" << errors_found << " errors)" << "\r" << flush;
         }
-    }
+    });
 
-    offset_file.close();
     bin_file.close();
 
+    if (postings_seen != header.numPostings) {
+        cerr << "[FAIL] Header has " << header.numPostings << " postings, index has " << postings_seen << endl;
+        errors_found++;
+    }
+
     cout << "\n\n--- Validation Complete ---" << endl;
     cout << "Total Terms: " << terms_checked << endl;
     cout << "Total Errors: " << errors_found << endl;
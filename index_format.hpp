@@ -0,0 +1,320 @@
+#ifndef INDEX_FORMAT_HPP
+#define INDEX_FORMAT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// index.bin starts with a fixed-size header holding the corpus statistics the
+// query side needs, so nothing has to be recomputed or hardcoded at startup.
+// The checksum is FNV-1a over every header byte before the checksum field.
+// Posting lists follow the header: int docfreq | Posting[docfreq].
+
+const char INDEX_MAGIC[8] = {'W', 'K', 'I', 'N', 'D', 'E', 'X', '\0'};
+const uint32_t INDEX_VERSION = 2;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t numDocs;
+    uint64_t totalDocLength;
+    double avgDocLength;
+    int64_t maxDocId;
+    uint64_t numTerms;
+    uint64_t numPostings;
+    uint64_t maxDocFreq;
+    uint64_t checksum;
+};
+
+inline uint64_t fnv1a(const void* data, size_t len, uint64_t h = 1469598103934665603ULL) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline uint64_t index_header_checksum(const IndexHeader& header) {
+    return fnv1a(&header, offsetof(IndexHeader, checksum));
+}
+
+inline IndexHeader make_index_header(uint64_t numDocs, uint64_t totalDocLength, int64_t maxDocId,
+                                     uint64_t numTerms, uint64_t numPostings, uint64_t maxDocFreq) {
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.headerSize = sizeof(IndexHeader);
+    header.numDocs = numDocs;
+    header.totalDocLength = totalDocLength;
+    header.avgDocLength = numDocs > 0 ? static_cast<double>(totalDocLength) / numDocs : 0.0;
+    header.maxDocId = maxDocId;
+    header.numTerms = numTerms;
+    header.numPostings = numPostings;
+    header.maxDocFreq = maxDocFreq;
+    header.checksum = index_header_checksum(header);
+    return header;
+}
+
+// Reads and verifies the header at the start of the stream. On failure `error`
+// says why; the stream position is left just past the header either way.
+inline bool read_index_header(istream& in, IndexHeader& header, string& error) {
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        error = "file too short for header";
+        return false;
+    }
+    if (memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        error = "bad magic, not an index.bin (or built by an older indexer)";
+        return false;
+    }
+    if (header.version != INDEX_VERSION || header.headerSize != sizeof(IndexHeader)) {
+        error = "unsupported index version " + to_string(header.version);
+        return false;
+    }
+    if (header.checksum != index_header_checksum(header)) {
+        error = "header checksum mismatch";
+        return false;
+    }
+    return true;
+}
+
+// Front-coded term dictionary (dictionary.bin).
+//
+// Terms are stored in strictly increasing byte order in blocks of
+// DICT_BLOCK_SIZE. The first term of a block is stored whole, every other
+// term as (shared prefix length, suffix). Each term carries the offset of its
+// posting list in index.bin, delta-coded against the previous term in the
+// block. A table of block start positions at the end of the file allows a
+// binary search over the block head terms.
+//
+//   DictionaryHeader
+//   block 0 .. block n-1
+//   uint64 block_offsets[n]    (relative to the start of the file)
+
+const char DICT_MAGIC[8] = {'W', 'K', 'D', 'I', 'C', 'T', '\0', '\0'};
+const uint32_t DICT_VERSION = 1;
+const uint32_t DICT_BLOCK_SIZE = 16;
+
+struct DictionaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockSize;
+    uint64_t numTerms;
+    uint64_t numBlocks;
+    uint64_t blockIndexOffset;
+};
+
+inline void write_varint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline uint64_t read_varint(const char*& p) {
+    uint64_t value = 0;
+    int shift = 0;
+    while (true) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+        shift += 7;
+    }
+}
+
+class DictionaryWriter {
+public:
+    bool open(const string& path) {
+        out.open(path, ios::binary);
+        if (!out.is_open()) return false;
+        DictionaryHeader header = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        return true;
+    }
+
+    // Terms must arrive in strictly increasing order.
+    void add(string_view term, uint64_t offset) {
+        if (numTerms % DICT_BLOCK_SIZE == 0) {
+            flushBlock();
+            blockOffsets.push_back(static_cast<uint64_t>(out.tellp()));
+            write_varint(block, term.size());
+            block.append(term.data(), term.size());
+            write_varint(block, offset);
+        } else {
+            size_t shared = 0;
+            size_t limit = min(previous.size(), term.size());
+            while (shared < limit && previous[shared] == term[shared]) shared++;
+            write_varint(block, shared);
+            write_varint(block, term.size() - shared);
+            block.append(term.data() + shared, term.size() - shared);
+            write_varint(block, offset - previousOffset);
+        }
+        previous.assign(term.data(), term.size());
+        previousOffset = offset;
+        numTerms++;
+    }
+
+    bool close() {
+        flushBlock();
+        DictionaryHeader header = {};
+        memcpy(header.magic, DICT_MAGIC, sizeof(DICT_MAGIC));
+        header.version = DICT_VERSION;
+        header.blockSize = DICT_BLOCK_SIZE;
+        header.numTerms = numTerms;
+        header.numBlocks = blockOffsets.size();
+        header.blockIndexOffset = static_cast<uint64_t>(out.tellp());
+
+        out.write(reinterpret_cast<const char*>(blockOffsets.data()), blockOffsets.size() * sizeof(uint64_t));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        return !out.fail();
+    }
+
+    uint64_t size() const { return numTerms; }
+
+private:
+    ofstream out;
+    string block;
+    string previous;
+    uint64_t previousOffset = 0;
+    uint64_t numTerms = 0;
+    vector<uint64_t> blockOffsets;
+
+    void flushBlock() {
+        out.write(block.data(), block.size());
+        block.clear();
+    }
+};
+
+class Dictionary {
+public:
+    bool load(const string& path) {
+        ifstream in(path, ios::binary | ios::ate);
+        if (!in.is_open()) return false;
+        streamoff size = in.tellg();
+        if (size < static_cast<streamoff>(sizeof(DictionaryHeader))) return false;
+        data.resize(size);
+        in.seekg(0);
+        in.read(data.data(), size);
+        if (!in) return false;
+
+        memcpy(&header, data.data(), sizeof(header));
+        if (memcmp(header.magic, DICT_MAGIC, sizeof(DICT_MAGIC)) != 0 || header.version != DICT_VERSION) return false;
+        if (header.blockIndexOffset + header.numBlocks * sizeof(uint64_t) > data.size()) return false;
+
+        blockOffsets.resize(header.numBlocks);
+        memcpy(blockOffsets.data(), data.data() + header.blockIndexOffset, header.numBlocks * sizeof(uint64_t));
+        return true;
+    }
+
+    uint64_t size() const { return header.numTerms; }
+
+    bool find(string_view term, long long& offset) const {
+        if (blockOffsets.empty()) return false;
+
+        // Last block whose head term is <= term.
+        size_t lo = 0, hi = blockOffsets.size();
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (blockHead(mid) <= term) lo = mid;
+            else hi = mid;
+        }
+
+        bool found = false;
+        scanBlock(lo, [&](string_view t, uint64_t off) {
+            if (t == term) {
+                offset = static_cast<long long>(off);
+                found = true;
+            }
+            return !found && t < term;
+        });
+        return found;
+    }
+
+    // Calls visit(term, offset) for every term starting with prefix, in order.
+    template <typename F>
+    void forEachWithPrefix(string_view prefix, F&& visit) const {
+        if (blockOffsets.empty()) return;
+
+        size_t lo = 0, hi = blockOffsets.size();
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (blockHead(mid) < prefix) lo = mid;
+            else hi = mid;
+        }
+
+        for (size_t b = lo; b < blockOffsets.size(); b++) {
+            bool more = scanBlock(b, [&](string_view t, uint64_t off) {
+                if (t.substr(0, prefix.size()) == prefix) {
+                    visit(t, off);
+                    return true;
+                }
+                return t < prefix;
+            });
+            if (!more) break;
+        }
+    }
+
+    // Calls visit(term, offset) for every term, in order.
+    template <typename F>
+    void forEach(F&& visit) const {
+        for (size_t b = 0; b < blockOffsets.size(); b++) {
+            scanBlock(b, [&](string_view t, uint64_t off) {
+                visit(t, off);
+                return true;
+            });
+        }
+    }
+
+private:
+    vector<char> data;
+    DictionaryHeader header = {};
+    vector<uint64_t> blockOffsets;
+
+    string_view blockHead(size_t b) const {
+        const char* p = data.data() + blockOffsets[b];
+        uint64_t len = read_varint(p);
+        return string_view(p, len);
+    }
+
+    // Decodes block b, calling step(term, offset) until it returns false.
+    // Returns false if the scan was stopped early.
+    template <typename F>
+    bool scanBlock(size_t b, F&& step) const {
+        const char* p = data.data() + blockOffsets[b];
+        uint64_t remaining = min<uint64_t>(header.blockSize, header.numTerms - b * header.blockSize);
+
+        string term;
+        uint64_t len = read_varint(p);
+        term.assign(p, len);
+        p += len;
+        uint64_t offset = read_varint(p);
+        if (!step(string_view(term), offset)) return false;
+
+        for (uint64_t i = 1; i < remaining; i++) {
+            uint64_t shared = read_varint(p);
+            uint64_t suffix = read_varint(p);
+            term.resize(shared);
+            term.append(p, suffix);
+            p += suffix;
+            offset += read_varint(p);
+            if (!step(string_view(term), offset)) return false;
+        }
+        return true;
+    }
+};
+
+#endif // INDEX_FORMAT_HPP
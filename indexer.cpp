@@ -0,0 +1,316 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <queue>
+#include <chrono>
+#include <cstdio>
+#include "json.hpp"
+#include "term_arena.hpp"
+#include "peak_rss.hpp"
+#include "index_format.hpp"
+#include "corpus_stats.hpp"
+using json = nlohmann::json;
+using namespace std;
+
+// Single-process SPIMI indexer. Streams tf_data.jsonl, inverts documents into an
+// in-memory block until the memory budget is hit, spills the block as a sorted
+// binary run and finally k-way merges all runs into index.bin + dictionary.bin.
+//
+// Usage: ./indexer [memory_budget_mb]
+
+const string TF_FILE_PATH = "data_files\\tf_data.jsonl";
+const string DOC_INFO_PATH = "data_files\\doc_info.jsonl";
+const string FINAL_INDEX = "index.bin";
+const string FINAL_DICTIONARY = "dictionary.bin";
+const string RUN_PREFIX = "spimi_run_";
+const long long DEFAULT_MEMORY_MB = 1024;
+
+struct Posting{
+    int id;
+    float score;
+};
+
+// One in-memory inverted block. Everything lives in the arena, so the block's
+// footprint is known exactly and is released in one go after a spill.
+struct Block{
+    explicit Block(size_t slabSize) : arena(slabSize) {}
+
+    Arena arena;
+    TermInterner terms{arena};
+    PostingChains<Posting> postings{arena};
+
+    size_t bytesUsed() const{
+        return arena.bytesReserved() + terms.bytesUsed() + postings.bytesUsed();
+    }
+
+    void clear(){
+        postings.clear();
+        terms.clear();
+        arena.reset();
+    }
+};
+
+string run_name(int run_id){
+    return RUN_PREFIX + to_string(run_id) + ".bin";
+}
+
+// Run layout, repeated per term in sorted term order:
+//   uint32 term_len | term bytes | int docfreq | Posting[docfreq]
+bool spill_block(Block& block, int run_id){
+    vector<uint32_t> order(block.terms.size());
+    for(uint32_t i=0; i<order.size(); i++) order[i] = i;
+
+    sort(order.begin(), order.end(), [&block](uint32_t a, uint32_t b){
+        return block.terms.term(a) < block.terms.term(b);
+    });
+
+    string fileName = run_name(run_id);
+    ofstream run(fileName, ios::binary);
+    if(!run.is_open()){
+        cerr << "Error: could not create run file " << fileName << endl;
+        return false;
+    }
+
+    for(uint32_t term_id : order){
+        string_view term = block.terms.term(term_id);
+
+        unsigned int term_len = term.length();
+        int docfreq = block.postings.size(term_id);
+        run.write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
+        run.write(term.data(), term_len);
+        run.write(reinterpret_cast<const char*>(&docfreq), sizeof(docfreq));
+        block.postings.forEachChunk(term_id, [&](const Posting* posts, uint32_t count){
+            run.write(reinterpret_cast<const char*>(posts), count * sizeof(Posting));
+        });
+    }
+
+    run.close();
+    cout << "\n----- Spilled run " << run_id << ": " << order.size() << " terms -----" << endl;
+
+    block.clear();
+    return true;
+}
+
+struct RunReader{
+    ifstream in;
+    string term;
+    int docfreq = 0;
+    bool done = false;
+
+    bool open(const string& fileName){
+        in.open(fileName, ios::binary);
+        return in.is_open();
+    }
+
+    // Reads the next term header. The postings are left in the stream and must
+    // be consumed with copy_postings before calling advance again.
+    void advance(){
+        unsigned int term_len;
+        if(!in.read(reinterpret_cast<char*>(&term_len), sizeof(term_len))){
+            done = true;
+            return;
+        }
+        term.resize(term_len);
+        in.read(term.data(), term_len);
+        in.read(reinterpret_cast<char*>(&docfreq), sizeof(docfreq));
+        if(!in) done = true;
+    }
+
+    void copy_postings(ofstream& out, vector<char>& buffer){
+        long long remaining = (long long)docfreq * sizeof(Posting);
+        while(remaining > 0){
+            long long step = min<long long>(remaining, buffer.size());
+            in.read(buffer.data(), step);
+            out.write(buffer.data(), step);
+            remaining -= step;
+        }
+    }
+};
+
+bool merge_runs(int num_runs, const CorpusStats& stats){
+    cout << "----- Merging " << num_runs << " runs -----" << endl;
+
+    vector<RunReader> runs(num_runs);
+    for(int i=0; i<num_runs; i++){
+        if(!runs[i].open(run_name(i))){
+            cerr << "Error: could not open run " << i << endl;
+            return false;
+        }
+        runs[i].advance();
+    }
+
+    ofstream final_bin(FINAL_INDEX, ios::binary);
+    DictionaryWriter dictionary;
+    if(!final_bin.is_open() || !dictionary.open(FINAL_DICTIONARY)){
+        cerr << "Final bin or Final Dictionary not opening" << endl;
+        return false;
+    }
+
+    // Placeholder, the real header is written once the totals are known.
+    IndexHeader header = {};
+    final_bin.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    unsigned long long num_postings = 0;
+    unsigned long long max_docfreq = 0;
+
+    // Min-heap on (term, run id). Runs hold documents in input order, so taking
+    // equal terms in run order keeps every posting list in document order.
+    auto cmp = [&runs](int a, int b){
+        if(runs[a].term != runs[b].term) return runs[a].term > runs[b].term;
+        return a > b;
+    };
+    priority_queue<int, vector<int>, decltype(cmp)> heap(cmp);
+    for(int i=0; i<num_runs; i++){
+        if(!runs[i].done) heap.push(i);
+    }
+
+    vector<char> buffer(1024*1024);
+    vector<int> same_term;
+    long long termsWritten = 0;
+
+    while(!heap.empty()){
+        same_term.clear();
+        same_term.push_back(heap.top());
+        heap.pop();
+        const string term = runs[same_term[0]].term;
+
+        while(!heap.empty() && runs[heap.top()].term == term){
+            same_term.push_back(heap.top());
+            heap.pop();
+        }
+        sort(same_term.begin(), same_term.end());
+
+        int docfreq = 0;
+        for(int r : same_term) docfreq += runs[r].docfreq;
+        num_postings += docfreq;
+        max_docfreq = max<unsigned long long>(max_docfreq, docfreq);
+
+        dictionary.add(term, final_bin.tellp());
+        final_bin.write(reinterpret_cast<const char*>(&docfreq), sizeof(docfreq));
+        for(int r : same_term){
+            runs[r].copy_postings(final_bin, buffer);
+            runs[r].advance();
+            if(!runs[r].done) heap.push(r);
+        }
+
+        termsWritten++;
+        if(termsWritten % 100000 == 0){
+            cout << termsWritten << " terms merged.\r" << flush;
+        }
+    }
+
+    header = make_index_header(stats.numDocs, stats.totalDocLength, stats.maxDocId, termsWritten, num_postings, max_docfreq);
+    final_bin.seekp(0);
+    final_bin.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    final_bin.close();
+    if(final_bin.fail() || !dictionary.close()){
+        cerr << "Error writing " << FINAL_INDEX << " or " << FINAL_DICTIONARY << endl;
+        return false;
+    }
+
+    for(int i=0; i<num_runs; i++){
+        runs[i].in.close();
+        remove(run_name(i).c_str());
+    }
+
+    cout << "\n----- Merged " << termsWritten << " terms into " << FINAL_INDEX << " -----" << endl;
+    return true;
+}
+
+int main(int argc, char* argv[]){
+
+    long long memory_mb = (argc > 1) ? stoll(argv[1]) : DEFAULT_MEMORY_MB;
+    const long long memory_budget = memory_mb * 1024 * 1024;
+
+    cout << "----- SPIMI Indexer (budget " << memory_mb << " MB) -----" << endl;
+
+    ifstream tfFile;
+    static char buffer[1024*1024];
+    tfFile.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
+    tfFile.open(TF_FILE_PATH);
+
+    if(!tfFile.is_open()){
+        cerr << "Error opening tf_data.jsonl" << endl;
+        return 1;
+    }
+
+    // Slabs are a fraction of the budget so the budget is not overshot by a whole slab.
+    Block block(clamp<long long>(memory_budget / 16, 1024*1024, 64*1024*1024));
+    int num_runs = 0;
+
+    string line;
+    line.reserve(10000);
+    int doc_id = 0;
+    int total_docs = 0;
+    long long termCounter = 0;
+
+    auto abs_start_time = chrono::high_resolution_clock::now();
+    auto batch_start_time = abs_start_time;
+
+    while(getline(tfFile, line)){
+        try{
+            auto j = json::parse(line);
+            doc_id = j["id"];
+
+            for(auto& item : j["terms"].items()){
+                const string& term = item.key();
+                float score = item.value();
+
+                if(term.length() < 2){
+                    continue;
+                }
+
+                block.postings.append(block.terms.intern(term), {doc_id, score});
+                termCounter++;
+            }
+            total_docs++;
+        }
+        catch(const json::parse_error& e){
+            cout << "Json parsing error on docID: " << doc_id << ". Error: " << e.what() << endl;
+            continue;
+        }
+        catch(const exception& e){
+            cout << "Standard error: " << e.what() << endl;
+            continue;
+        }
+
+        if((long long)block.bytesUsed() >= memory_budget){
+            if(!spill_block(block, num_runs)) return 1;
+            num_runs++;
+        }
+
+        if(total_docs % 100000 == 0){
+            auto current_time = chrono::high_resolution_clock::now();
+            auto batch_duration = chrono::duration_cast<chrono::milliseconds>(current_time - batch_start_time);
+            auto abs_duration = chrono::duration_cast<chrono::seconds>(current_time - abs_start_time).count();
+            int minutes = abs_duration / 60;
+            int seconds = abs_duration % 60;
+
+            cout << total_docs << " docs indexed. Block: " << block.bytesUsed() / (1024*1024) << " MB. Batch Time: " << batch_duration.count() / 1000.0 << " seconds. Total time: " << minutes << " min, " << seconds << " sec.\r" << flush;
+            batch_start_time = current_time;
+        }
+    }
+
+    tfFile.close();
+
+    if(block.terms.size() > 0){
+        if(!spill_block(block, num_runs)) return 1;
+        num_runs++;
+    }
+
+    cout << "----- Inversion Complete: " << total_docs << " docs, " << termCounter << " postings -----" << endl;
+
+    CorpusStats stats;
+    if(!compute_corpus_stats(DOC_INFO_PATH, stats)) return 1;
+    if(stats.numDocs != (unsigned long long)total_docs){
+        cerr << "Warning: doc_info.jsonl has " << stats.numDocs << " docs but " << total_docs << " were indexed" << endl;
+    }
+
+    if(!merge_runs(num_runs, stats)) return 1;
+
+    auto abs_duration = chrono::duration_cast<chrono::seconds>(chrono::high_resolution_clock::now() - abs_start_time).count();
+    cout << "Total time: " << abs_duration / 60 << " min, " << abs_duration % 60 << " sec. Peak RSS: " << peak_rss_bytes() / (1024*1024) << " MB." << endl;
+
+    return 0;
+}
@@ -1,9 +1,11 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <unordered_map>
 #include <string>
 #include <chrono>
+#include <algorithm>
+#include "term_arena.hpp"
+#include "peak_rss.hpp"
 using namespace std;
 
 struct Posting{
@@ -22,11 +24,15 @@ int main(int argc, char* argv[]){
 
     string FILE_NAME = "temp_" + to_string(shard_id) + ".txt";
     string OUTPUT_BIN = "chunk_" + to_string(shard_id) + ".bin";
-    string OUTPUT_OFFSET = "chunk_offsets_" + to_string(shard_id) + ".txt";
+    string OUTPUT_OFFSET = "chunk_offsets_" + to_string(shard_id) + ".bin";
 
     cout << "----- Processing Shard ID" << shard_id << " -----" << endl;
 
-    unordered_map<string, vector<Posting>> index;
+    // Terms are interned to dense ids and postings go into per-term chunk chains,
+    // all carved out of one arena instead of millions of strings and vectors.
+    Arena arena;
+    TermInterner terms(arena);
+    PostingChains<Posting> index(arena);
 
     ifstream inFile;
     static char buffer[1024*1024];
@@ -47,7 +53,7 @@ int main(int argc, char* argv[]){
     auto chunk_start_time = abs_start_time;
     
     while(inFile >> term >> doc_id >> score){
-        index[term].push_back({doc_id, score});
+        index.append(terms.intern(term), {doc_id, score});
 
         termcounter++;
         if(termcounter % 200000 == 0){
@@ -67,33 +73,48 @@ int main(int argc, char* argv[]){
     cout << "\n----- Done building Map -----" <<endl;
 
     ofstream bin_file(OUTPUT_BIN, ios::binary);
-    ofstream offset_file(OUTPUT_OFFSET);
+    ofstream offset_file(OUTPUT_OFFSET, ios::binary);
 
     if(!bin_file.is_open() || !offset_file.is_open()){
         cerr << "Bin file or Offset File not opening" << endl;
         return 1;
     }
 
-    int totalpairs = index.size();
+    int totalpairs = terms.size();
     int paircount = 0;
+    auto build_start_time = abs_start_time;
     abs_start_time = chrono::high_resolution_clock::now();
     chunk_start_time = abs_start_time;
 
-    for(const auto& pair : index){
-        const string& term = pair.first;
-        const vector<Posting>& posts = pair.second;
+    // Shards are written in term order so mergebins can k-way merge them.
+    vector<uint32_t> order(terms.size());
+    for(uint32_t i=0; i<order.size(); i++) order[i] = i;
+    sort(order.begin(), order.end(), [&terms](uint32_t a, uint32_t b){
+        return terms.term(a) < terms.term(b);
+    });
 
-        long long pos = bin_file.tellp();
-        
-        offset_file.write(term.c_str(), term.length());
-        offset_file.put(' ');
-        offset_file << pos;
-        offset_file.put('\n');
+    // Offset table record per term: uint32 term_len | term | uint64 pos | uint64 length,
+    // where [pos, pos + length) is the docfreq + postings block in the chunk.
+    unsigned long long pos = 0;
+
+    for(uint32_t term_id : order){
+        string_view term = terms.term(term_id);
+
+        int docfreq = index.size(term_id);
+        unsigned int term_len = term.length();
+        unsigned long long length = sizeof(docfreq) + (unsigned long long)docfreq * sizeof(Posting);
+
+        offset_file.write(reinterpret_cast<const char*>(&term_len), sizeof(term_len));
+        offset_file.write(term.data(), term_len);
+        offset_file.write(reinterpret_cast<const char*>(&pos), sizeof(pos));
+        offset_file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        pos += length;
 
-        int docfreq = posts.size();
         bin_file.write(reinterpret_cast<const char*>(&docfreq), sizeof(docfreq));
 
-        bin_file.write(reinterpret_cast<const char*>(posts.data()), docfreq * sizeof(Posting));
+        index.forEachChunk(term_id, [&](const Posting* posts, uint32_t count){
+            bin_file.write(reinterpret_cast<const char*>(posts), count * sizeof(Posting));
+        });
 
         paircount++;
         if(paircount % 100000 == 0){
@@ -111,7 +132,9 @@ int main(int argc, char* argv[]){
     bin_file.close();
     offset_file.close();
 
+    auto total_duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - build_start_time);
     cout << "\n----- Saved " << OUTPUT_BIN << " -----" << endl;
+    cout << "Build time: " << total_duration.count() / 1000.0 << " sec. Arena: " << arena.bytesReserved() / (1024*1024) << " MB. Peak RSS: " << peak_rss_bytes() / (1024*1024) << " MB." << endl;
 
     return 0;
 }
\ No newline at end of file
@@ -2,66 +2,336 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <queue>
+#include <algorithm>
+#include <cstdio>
+#include "index_format.hpp"
+#include "corpus_stats.hpp"
+
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/sendfile.h>
+#endif
+
 using namespace std;
 
 const int NUM_SHARDS = 32;
 const string FINAL_INDEX = "index.bin";
-const string FINAL_OFFSET = "offset.txt";
-const int TOTAL_DOCS = 7084107;
+const string FINAL_DICTIONARY = "dictionary.bin";
+const string DOC_INFO_PATH = "data_files\\doc_info.jsonl";
+
+struct Posting{
+    int id;
+    float score;
+};
+
+// Appends byte ranges of the shard chunks to the output. Each chunk is consumed
+// front to back, so small ranges are read sequentially through stdio and batched
+// into one large output buffer. Ranges of at least ZERO_COPY_MIN bytes are moved
+// by the kernel with copy_file_range (or sendfile on older kernels / across
+// filesystems) on Linux and never pass through userspace.
+class RangeCopier{
+public:
+    static constexpr unsigned long long ZERO_COPY_MIN = 1024*1024;
+
+    explicit RangeCopier(FILE* out) : out(out) { buffer.reserve(8*1024*1024); }
+
+    // `in_pos` is the current stdio position of `in` and is updated.
+    bool copy(FILE* in, unsigned long long& in_pos, unsigned long long offset, unsigned long long len){
+        #ifdef __linux__
+            if(len >= ZERO_COPY_MIN && kernel_copy){
+                if(!flush()) return false;
+                unsigned long long copied = kernel_copy_range(fileno(in), offset, len);
+                offset += copied;
+                len -= copied;
+            }
+        #endif
+
+        if(in_pos != offset){
+            if(seek(in, offset) != 0) return false;
+            in_pos = offset;
+        }
+
+        while(len > 0){
+            if(buffer.size() == buffer.capacity() && !flush()) return false;
+            size_t step = min<unsigned long long>(len, buffer.capacity() - buffer.size());
+            size_t old_size = buffer.size();
+            buffer.resize(old_size + step);
+            size_t got = fread(buffer.data() + old_size, 1, step, in);
+            buffer.resize(old_size + got);
+            if(got == 0) return false;
+            in_pos += got;
+            len -= got;
+        }
+        return true;
+    }
+
+    bool write_all(const char* data, size_t len){
+        if(buffer.size() + len > buffer.capacity() && !flush()) return false;
+        buffer.insert(buffer.end(), data, data + len);
+        return true;
+    }
+
+    bool flush(){
+        bool ok = raw_write(buffer.data(), buffer.size());
+        buffer.clear();
+        return ok;
+    }
 
+private:
+    FILE* out;
+    vector<char> buffer;
+    bool kernel_copy = true;
+    bool use_sendfile = false;
+
+    static int seek(FILE* f, unsigned long long offset){
+        #ifdef _WIN32
+            return _fseeki64(f, offset, SEEK_SET);
+        #else
+            return fseeko(f, offset, SEEK_SET);
+        #endif
+    }
+
+    bool raw_write(const char* data, size_t len){
+        #ifdef __linux__
+            int out_fd = fileno(out);
+            while(len > 0){
+                ssize_t n = write(out_fd, data, len);
+                if(n <= 0) return false;
+                data += n;
+                len -= n;
+            }
+            return true;
+        #else
+            return fwrite(data, 1, len, out) == len;
+        #endif
+    }
+
+    #ifdef __linux__
+    // Returns how many bytes the kernel copied; the caller finishes the rest.
+    unsigned long long kernel_copy_range(int in_fd, unsigned long long offset, unsigned long long len){
+        int out_fd = fileno(out);
+        unsigned long long copied = 0;
+        while(copied < len && kernel_copy){
+            off64_t src = offset + copied;
+            ssize_t n = use_sendfile ? sendfile(out_fd, in_fd, &src, len - copied)
+                                     : copy_file_range(in_fd, &src, out_fd, nullptr, len - copied, 0);
+            if(n > 0){
+                copied += n;
+            }
+            else if(n < 0 && !use_sendfile){
+                use_sendfile = true;
+            }
+            else{
+                kernel_copy = false;
+            }
+        }
+        return copied;
+    }
+    #endif
+};
+
+// One sorted shard. Its binary offset table is streamed record by record and
+// gives, per term, the byte range of the docfreq + postings block in the chunk.
+struct ShardReader{
+    ifstream offsets;
+    FILE* bin = nullptr;
+    string term;
+    unsigned long long pos = 0;
+    unsigned long long length = 0;
+    unsigned long long bin_pos = 0;
+    bool done = false;
+
+    bool open(int shard_id){
+        static char buffer[NUM_SHARDS][256*1024];
+        offsets.rdbuf()->pubsetbuf(buffer[shard_id], sizeof(buffer[shard_id]));
+        offsets.open("chunk_offsets_" + to_string(shard_id) + ".bin", ios::binary);
+        bin = fopen(("chunk_" + to_string(shard_id) + ".bin").c_str(), "rb");
+        if(bin) setvbuf(bin, nullptr, _IOFBF, 1024*1024);
+        return offsets.is_open() && bin != nullptr;
+    }
+
+    void advance(){
+        unsigned int term_len;
+        if(!offsets.read(reinterpret_cast<char*>(&term_len), sizeof(term_len))){
+            done = true;
+            return;
+        }
+        term.resize(term_len);
+        offsets.read(term.data(), term_len);
+        offsets.read(reinterpret_cast<char*>(&pos), sizeof(pos));
+        offsets.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if(!offsets) done = true;
+    }
+
+    int read_docfreq(){
+        int docfreq = 0;
+        if(bin_pos != pos){
+            #ifdef _WIN32
+                _fseeki64(bin, pos, SEEK_SET);
+            #else
+                fseeko(bin, pos, SEEK_SET);
+            #endif
+            bin_pos = pos;
+        }
+        if(fread(&docfreq, sizeof(docfreq), 1, bin) != 1) return 0;
+        bin_pos += sizeof(docfreq);
+        return docfreq;
+    }
+
+    void close(){
+        offsets.close();
+        if(bin) fclose(bin);
+        bin = nullptr;
+    }
+};
 
 int main(){
 
-    ofstream final_bin(FINAL_INDEX, ios::binary);
-    ofstream final_offset(FINAL_OFFSET);
+    CorpusStats stats;
+    if(!compute_corpus_stats(DOC_INFO_PATH, stats)){
+        return 1;
+    }
+
+    FILE* final_bin = fopen(FINAL_INDEX.c_str(), "wb");
+    DictionaryWriter dictionary;
 
-    if(!final_bin.is_open() || !final_offset.is_open()){
-        cerr << "Final bin or Final Offset not opening";
+    if(final_bin == nullptr || !dictionary.open(FINAL_DICTIONARY)){
+        cerr << "Final bin or Final Dictionary not opening";
         return 1;
     }
 
-    final_bin.write(reinterpret_cast<const char*>(&TOTAL_DOCS), sizeof(TOTAL_DOCS));
+    RangeCopier copier(final_bin);
+    unsigned long long out_pos = 0;
 
+    // Placeholder, the real header is written once the totals are known.
+    IndexHeader header = {};
+    copier.write_all(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_pos += sizeof(header);
+    unsigned long long num_postings = 0;
+    unsigned long long max_docfreq = 0;
+
+    vector<ShardReader> shards(NUM_SHARDS);
     for(int i=0; i<NUM_SHARDS; i++){
-        string chunk_bin_name = "chunk_" + to_string(i) + ".bin";
-        string chunk_offset_name = "chunk_offsets_" + to_string(i) + ".txt";
-
-        cout << "----- Merging File " << i << " -----" <<endl;
-        
-        long long global_base_offset = final_bin.tellp();
-        ifstream chunk_offset(chunk_offset_name);
-        string term;
-        long long localpos;
-
-        if(!chunk_offset.is_open()){
-            cerr << "Chunk offset " << i << " did not open";
+        if(!shards[i].open(i)){
+            cerr << "Chunk " << i << " did not open";
             return 1;
         }
+        shards[i].advance();
+    }
 
-        while(chunk_offset >> term >> localpos){
-            long long finalpos = global_base_offset + localpos;
+    // Min-heap on (term, shard id) so the dictionary and the posting lists come
+    // out in global lexicographic order. With hash sharding a term lives in a
+    // single shard, but equal terms from several shards are concatenated anyway.
+    auto cmp = [&shards](int a, int b){
+        if(shards[a].term != shards[b].term) return shards[a].term > shards[b].term;
+        return a > b;
+    };
+    priority_queue<int, vector<int>, decltype(cmp)> heap(cmp);
+    for(int i=0; i<NUM_SHARDS; i++){
+        if(!shards[i].done) heap.push(i);
+    }
 
-            final_offset << term << " " << finalpos << '\n';
+    cout << "----- Merging " << NUM_SHARDS << " shards -----" << endl;
+
+    // Consecutive terms from the same shard are contiguous in its chunk, so they
+    // are coalesced into one pending range and copied with a single call.
+    int pending_shard = -1;
+    unsigned long long pending_pos = 0;
+    unsigned long long pending_len = 0;
+    bool ok = true;
+
+    auto flush_pending = [&](){
+        if(pending_len > 0){
+            ShardReader& shard = shards[pending_shard];
+            ok = ok && copier.copy(shard.bin, shard.bin_pos, pending_pos, pending_len);
         }
+        pending_shard = -1;
+        pending_len = 0;
+    };
 
-        chunk_offset.close();
+    vector<int> same_term;
+    long long termsWritten = 0;
 
-        ifstream chunkbin(chunk_bin_name, ios::binary);
+    while(!heap.empty() && ok){
+        same_term.clear();
+        same_term.push_back(heap.top());
+        heap.pop();
+        const string term = shards[same_term[0]].term;
 
-        if(!chunkbin.is_open()){
-            cerr << "Chunk Bin" << i << " did not open";
-            return 1;
+        while(!heap.empty() && shards[heap.top()].term == term){
+            same_term.push_back(heap.top());
+            heap.pop();
         }
 
-        final_bin << chunkbin.rdbuf();
-        chunkbin.close();
+        dictionary.add(term, out_pos);
 
-        cout << "----- Chunk " << i << " finished combining -----" << endl;
+        if(same_term.size() == 1){
+            ShardReader& shard = shards[same_term[0]];
+            if(pending_shard != same_term[0] || pending_pos + pending_len != shard.pos){
+                flush_pending();
+                pending_shard = same_term[0];
+                pending_pos = shard.pos;
+            }
+            pending_len += shard.length;
+            out_pos += shard.length;
 
+            unsigned long long docfreq = (shard.length - sizeof(int)) / sizeof(Posting);
+            num_postings += docfreq;
+            max_docfreq = max(max_docfreq, docfreq);
+        }
+        else{
+            flush_pending();
+            sort(same_term.begin(), same_term.end());
+
+            int docfreq = 0;
+            for(int s : same_term) docfreq += shards[s].read_docfreq();
+            num_postings += docfreq;
+            max_docfreq = max<unsigned long long>(max_docfreq, docfreq);
+            ok = ok && copier.write_all(reinterpret_cast<const char*>(&docfreq), sizeof(docfreq));
+            out_pos += sizeof(docfreq);
+
+            for(int s : same_term){
+                unsigned long long postings_len = shards[s].length - sizeof(docfreq);
+                ok = ok && copier.copy(shards[s].bin, shards[s].bin_pos, shards[s].pos + sizeof(docfreq), postings_len);
+                out_pos += postings_len;
+            }
+        }
+
+        for(int s : same_term){
+            shards[s].advance();
+            if(!shards[s].done) heap.push(s);
+        }
+
+        termsWritten++;
+        if(termsWritten % 100000 == 0){
+            cout << termsWritten << " terms merged.\r" << flush;
+        }
+    }
+    flush_pending();
+    ok = ok && copier.flush();
+
+    header = make_index_header(stats.numDocs, stats.totalDocLength, stats.maxDocId, termsWritten, num_postings, max_docfreq);
+    #ifdef _WIN32
+        ok = ok && _fseeki64(final_bin, 0, SEEK_SET) == 0;
+    #else
+        ok = ok && fseeko(final_bin, 0, SEEK_SET) == 0;
+    #endif
+    ok = ok && fwrite(&header, sizeof(header), 1, final_bin) == 1;
+    ok = fclose(final_bin) == 0 && ok;
+    for(auto& shard : shards) shard.close();
+
+    if(!ok){
+        cerr << "Error copying postings into " << FINAL_INDEX << endl;
+        return 1;
+    }
+    if(!dictionary.close()){
+        cerr << "Error writing " << FINAL_DICTIONARY << endl;
+        return 1;
     }
 
-    final_bin.close();
-    final_offset.close();
+    cout << "\n----- Merged " << termsWritten << " terms, " << num_postings << " postings, " << out_pos << " bytes -----" << endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,108 @@
+#ifndef MMAP_FILE_HPP
+#define MMAP_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN     // keeps out winsock.h, which clashes with winsock2.h
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+// Read-only memory mapping of a whole file. Pages are shared with every other
+// process mapping the same file and with the OS page cache.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string& path) {
+        close();
+        #ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+                close();
+                return false;
+            }
+            length = static_cast<size_t>(size.QuadPart);
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr) {
+                close();
+                return false;
+            }
+            base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (base == nullptr) {
+                close();
+                return false;
+            }
+        #else
+            fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                close();
+                return false;
+            }
+            length = static_cast<size_t>(st.st_size);
+            void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) {
+                close();
+                return false;
+            }
+            base = static_cast<const char*>(p);
+        #endif
+        return true;
+    }
+
+    void close() {
+        #ifdef _WIN32
+            if (base) UnmapViewOfFile(base);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+        #else
+            if (base) munmap(const_cast<char*>(base), length);
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+        #endif
+        base = nullptr;
+        length = 0;
+    }
+
+    // Hint that the whole mapping will be read soon (sequential scans).
+    void willNeed() const {
+        #ifndef _WIN32
+            if (base) madvise(const_cast<char*>(base), length, MADV_WILLNEED);
+        #endif
+    }
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+    bool isOpen() const { return base != nullptr; }
+
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+    #ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+    #else
+        int fd = -1;
+    #endif
+};
+
+#endif // MMAP_FILE_HPP
@@ -2,233 +2,978 @@
 #include <fstream>
 #include <vector>
 #include <string>
-#include <unordered_map>
 #include <cmath>
 #include <iomanip>
 #include <algorithm>
 #include <numeric>
-#include <unordered_set>
-#include "json.hpp"
-using json = nlohmann::json;
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <filesystem>
+#include <chrono>
+#include <deque>
+#include <sstream>
+#include <array>
+#include "doc_info.hpp"
+#include "index_format.hpp"
+#include "mmap_file.hpp"
+#include "thread_pool.hpp"
+#include "score_file.hpp"
 
 using namespace std;
 
+// Usage: ./pageRank [--solver jacobi|gauss-seidel|aitken|quadratic] [--tolerance L1]
+//                   [--iterations MAX] [--damping D] [--threads T]
+//                   [--order none|degree|rcm] [--encoding raw|gaps] [--topics FILE]
+//                   [--signals] [--rebuild]
+//        ./pageRank --incremental delta.csv [--previous scores.csv] [solver options]
+//
+// The link graph is parsed from pagelinks.csv once and cached as a binary CSR
+// file next to it. Later runs map the cache directly and skip the CSV; the cache
+// is rebuilt when pagelinks.csv changes or --rebuild is given.
+//
+// --incremental applies a file of added/removed links to the cached graph and
+// updates the previous scores instead of starting from scratch.
+//
+// --topics computes personalised PageRank vectors for the topics listed in a
+// file and stores them in pagerank_topics.bin for search.cpp. --signals adds
+// in-degree, HITS and CheiRank in link_signals.bin.
+//
+// --order renumbers the nodes (out-degree sort or reverse Cuthill-McKee) so
+// the random reads in the pull loop hit fewer cache lines. The renumbered graph
+// replaces the cache, so the cost is paid once; dense_to_real maps the scores
+// back to page ids when they are written.
+//
+// --encoding gaps stores the in-link lists gap and varint coded instead of as
+// 32-bit ids, and the solvers decode them on the fly. Like --order, the choice
+// is kept in the cache.
+
 const string DOC_INFO_PATH = "data_files\\doc_info.jsonl";
 const string PAGELINKS_FILE = "data_files\\pagelinks.csv";
+const string GRAPH_CACHE_FILE = "data_files\\pagelinks.csr";
 const string OUTPUT_FILE = "pagerank_scores.csv";
-const int NUM_ITERATIONS = 20;
+const string BINARY_OUTPUT_FILE = "pagerank_scores.bin";
+const int MAX_ITERATIONS = 200;
 const double DAMPING_FACTOR = 0.85;
+const double TOLERANCE = 1e-8;
+const int EXTRAPOLATION_PERIOD = 10;
+const string SOLVERS[] = {"jacobi", "gauss-seidel", "aitken", "quadratic"};
+
+int num_iterations = MAX_ITERATIONS;
+double damping_factor = DAMPING_FACTOR;
+double tolerance = TOLERANCE;
+string solver = "jacobi";
+unsigned num_threads = max(1u, thread::hardware_concurrency());
+string node_order;
+string link_encoding;
+
+// Graph cache layout. Every array starts on a 64-byte boundary so it can be
+// used in place from the mapping.
+//   CsrHeader
+//   uint64 in_offsets[N+1]     in-neighbours of v are in_neighbours[in_offsets[v] .. in_offsets[v+1])
+//   int32  in_neighbours[E]
+//   int32  out_degree[N]
+//   int32  dense_to_real[N]
+//
+// With the gaps encoding the first two arrays are replaced by
+//   uint64 block_offsets[B+1]  B = ceil(N / LINK_BLOCK); block b starts at links[block_offsets[b]]
+//   uint8  links[...]          per node: varint in-degree, then the sorted
+//                              in-neighbours, the first as a zigzag varint of
+//                              (u - v) and the rest as varint gaps
+// Block offsets give random access to every LINK_BLOCK-th node; nodes inside a
+// block are reached by decoding the rows before them.
+const char CSR_MAGIC[8] = {'W', 'K', 'C', 'S', 'R', '\0', '\0', '\0'};
+const uint32_t CSR_VERSION = 3;
+const string NODE_ORDERS[] = {"none", "degree", "rcm"};
+const string LINK_ENCODINGS[] = {"raw", "gaps"};
+const int LINK_BLOCK = 64;
 
-unordered_set<int> valid_pageids;
+struct CsrHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t ordering;      // index into NODE_ORDERS
+    uint32_t encoding;      // index into LINK_ENCODINGS, always 0 before version 3
+    uint64_t numNodes;
+    uint64_t numEdges;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t offsetsPos;
+    uint64_t neighboursPos;
+    uint64_t outDegreePos;
+    uint64_t denseToRealPos;
+    uint64_t checksum;
+};
 
-unordered_map<int, int> real_to_dense;
+// In-link graph in compressed sparse row form. The arrays either point into
+// the mapped cache file or into the vectors filled by the CSV passes. Only one
+// of in_offsets/in_neighbours and block_offsets/links is set, by encoding.
+struct CsrGraph{
+    uint32_t ordering = 0;
+    uint32_t encoding = 0;
+    int N = 0;
+    long long E = 0;
+    const unsigned long long* in_offsets = nullptr;
+    const int* in_neighbours = nullptr;
+    const unsigned long long* block_offsets = nullptr;
+    const char* links = nullptr;
+    const int* out_degree = nullptr;
+    const int* dense_to_real = nullptr;
+};
+
+CsrGraph graph;
+MappedFile graph_file;
+
+// Real page id -> dense node id, indexed directly by the page id. Page ids are
+// dense enough (max ~81M for ~7M pages) that one int32 per possible id is
+// cheaper than any hash table, and every lookup is a single load.
+const int NOT_A_PAGE = -2;
+const int UNSEEN_PAGE = -1;
+vector<int> id_table;
 vector<int> dense_to_real;
 
-vector<vector<int>> inLinks_graph;
+vector<unsigned long long> in_offsets;
+vector<int> in_neighbours;
 vector<int> out_degree;
 vector<int> in_degree;
 
+// Parses a non-negative decimal integer at p, advancing p past it.
+bool parse_int(const char*& p, const char* end, int& value){
+    auto [next, ec] = from_chars(p, end, value);
+    if(ec != errc() || value < 0) return false;
+    p = next;
+    return true;
+}
+
+// Page ids are read straight from the mapped doc_info.jsonl: "id" is the first
+// key of every line, so no JSON parsing is needed.
 void find_valid_pageids(){
-    valid_pageids.reserve(7084107);
-    ifstream docinfo(DOC_INFO_PATH);
-    if(!docinfo.is_open()){
+    MappedFile docinfo;
+    if(!docinfo.open(DOC_INFO_PATH)){
         cerr << "Error: Could not open docinfo";
         exit(1);
     }
+    docinfo.willNeed();
 
-    string line;
-    int count=0;
-    while(getline(docinfo, line)){
-        try{
-            auto j = json::parse(line);
-            int doc_id = j["id"];
-            valid_pageids.insert(doc_id);
-        
-            count++;
-            if(count % 100000 == 0){
-                cout << count << " pages added to set...\r" << flush;
+    const char* p = docinfo.data();
+    const char* end = p + docinfo.size();
+    const string_view key = "\"id\":";
+
+    vector<int> ids;
+    int max_id = -1;
+    long long bad_lines = 0;
+    while(p < end){
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if(line_end == nullptr) line_end = end;
+
+        string_view line(p, line_end - p);
+        size_t key_pos = line.find(key);
+        int doc_id;
+        bool ok = false;
+        if(key_pos != string_view::npos){
+            const char* q = p + key_pos + key.size();
+            while(q < line_end && *q == ' ') q++;
+            ok = parse_int(q, line_end, doc_id);
+        }
+
+        if(ok){
+            ids.push_back(doc_id);
+            max_id = max(max_id, doc_id);
+            if(ids.size() % 1000000 == 0){
+                cout << ids.size() << " pages read...\r" << flush;
             }
         }
-        catch(exception &e){
-            cout << "Error (while making set): " << e.what() << endl;
-            continue;
+        else if(!line.empty()){
+            bad_lines++;
         }
+
+        p = line_end + 1;
     }
+
+    id_table.assign(max_id + 1, NOT_A_PAGE);
+    for(int id : ids) id_table[id] = UNSEEN_PAGE;
+
     cout << endl;
-    cout << "Valid pages set complete" << endl;
-    return;
+    if(bad_lines > 0) cout << "Warning: " << bad_lines << " doc_info lines without an id" << endl;
+    cout << "Valid pages table complete: " << ids.size() << " pages, max id " << max_id << endl;
 }
 
-int map_ids_pass_one(){
-    cout << "Pass 1: Discovering unique nodes..." << endl;
-    ifstream infile(PAGELINKS_FILE);
-    if(!infile.is_open()){
-        cerr << "Error: Pagelinks not opening in Pass 1";
-        exit(1); 
-    }
+inline void prefetch(const void* p){
+    #if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(p);
+    #endif
+}
 
-    string line;
-    int u_real, v_real;
+// Calls visit(u_real, v_real) for every well-formed "u,v" line of the mapped
+// pagelinks.csv whose endpoints are both valid pages. Lines are parsed in
+// batches and the id_table entries of a batch are prefetched before any of
+// them is used, so the cache misses on the table overlap instead of stalling
+// one after another.
+template<typename F>
+void for_each_link(const MappedFile& csv, F&& visit){
+    const int BATCH = 64;
+    const char* p = csv.data();
+    const char* end = p + csv.size();
+    const int table_size = id_table.size();
     long long line_count = 0;
+    long long bad_lines = 0;
+    auto start_time = chrono::high_resolution_clock::now();
 
-    while(getline(infile, line)){
-        size_t comma_pos = line.find(',');
-        if(comma_pos == string::npos) continue;
-        try{
-            u_real = stoi(line.substr(0, comma_pos));
-            v_real = stoi(line.substr(comma_pos+1));
+    int batch_u[BATCH], batch_v[BATCH];
+    while(p < end){
+        int count = 0;
+        while(count < BATCH && p < end){
+            const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+            if(line_end == nullptr) line_end = end;
 
-            if((valid_pageids.find(u_real) == valid_pageids.end()) || (valid_pageids.find(v_real) == valid_pageids.end())){
-                continue;
+            int u_real, v_real;
+            const char* q = p;
+            bool ok = parse_int(q, line_end, u_real) && q < line_end && *q++ == ',' && parse_int(q, line_end, v_real)
+                   && (q == line_end || *q == '\r');
+            if(!ok){
+                if(line_end > p) bad_lines++;
+            }
+            else if(u_real < table_size && v_real < table_size){
+                prefetch(&id_table[u_real]);
+                prefetch(&id_table[v_real]);
+                batch_u[count] = u_real;
+                batch_v[count] = v_real;
+                count++;
             }
 
-            if(real_to_dense.find(u_real) == real_to_dense.end()){
-                int new_id = real_to_dense.size();
-                real_to_dense[u_real] = new_id;
-                dense_to_real.push_back(u_real);
-                out_degree.push_back(0);
-                in_degree.push_back(0);
+            p = line_end + 1;
+            line_count++;
+            if(line_count % 5000000 == 0){
+                cout << "Scanned " << line_count << " lines...\r" << flush;
             }
+        }
+
+        for(int k=0; k<count; k++){
+            if(id_table[batch_u[k]] != NOT_A_PAGE && id_table[batch_v[k]] != NOT_A_PAGE){
+                visit(batch_u[k], batch_v[k]);
+            }
+        }
+    }
+    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - start_time);
+    cout << "Scanned " << line_count << " lines in " << duration.count() / 1000.0 << " sec." << endl;
+    if(bad_lines > 0) cout << "Warning: skipped " << bad_lines << " malformed lines" << endl;
+}
 
-            if(real_to_dense.find(v_real) == real_to_dense.end()){
-                int new_id = real_to_dense.size();
-                real_to_dense[v_real] = new_id;
-                dense_to_real.push_back(v_real);
+int map_ids_pass_one(const MappedFile& csv){
+    cout << "Pass 1: Discovering unique nodes..." << endl;
+
+    for_each_link(csv, [](int u_real, int v_real){
+        for(int real : {u_real, v_real}){
+            if(id_table[real] == UNSEEN_PAGE){
+                id_table[real] = dense_to_real.size();
+                dense_to_real.push_back(real);
                 out_degree.push_back(0);
                 in_degree.push_back(0);
             }
+        }
+        out_degree[id_table[u_real]]++;
+        in_degree[id_table[v_real]]++;
+    });
+
+    int N = dense_to_real.size();
+    cout << "Total unique nodes: " << N << endl;
+    return N;
+}
+
+
+void build_graph_pass_two(const MappedFile& csv, int N){
+    cout << "Pass 2: Building CSR graph..." << endl;
+
+    // Prefix sums of the in-degrees give each node's slice of in_neighbours.
+    in_offsets.assign(N + 1, 0);
+    for(int i=0; i<N; i++){
+        in_offsets[i + 1] = in_offsets[i] + in_degree[i];
+    }
+    in_neighbours.resize(in_offsets[N]);
+
+    // in_degree is reused as the per-node fill cursor.
+    fill(in_degree.begin(), in_degree.end(), 0);
+    cout << "  Memory ready (" << in_offsets[N] << " edges). Filling graph..." << endl;
+
+    for_each_link(csv, [](int u_real, int v_real){
+        int u_dense = id_table[u_real];
+        int v_dense = id_table[v_real];
+        in_neighbours[in_offsets[v_dense] + in_degree[v_dense]++] = u_dense;
+    });
+
+    vector<int>().swap(in_degree);
+    vector<int>().swap(id_table);
+
+    graph.N = N;
+    graph.E = in_offsets[N];
+    graph.in_offsets = in_offsets.data();
+    graph.in_neighbours = in_neighbours.data();
+    graph.out_degree = out_degree.data();
+    graph.dense_to_real = dense_to_real.data();
+    cout << "Graph Loaded." << endl;
+}
 
-            int u_dense = real_to_dense[u_real];
-            int v_dense = real_to_dense[v_real];
-            
-            out_degree[u_dense]++;
-            in_degree[v_dense]++;
+// Size and modification time of pagelinks.csv, stored in the cache so a stale
+// cache is detected.
+bool source_stamp(uint64_t& size, int64_t& mtime){
+    error_code ec;
+    size = filesystem::file_size(PAGELINKS_FILE, ec);
+    if(ec) return false;
+    auto time = filesystem::last_write_time(PAGELINKS_FILE, ec);
+    if(ec) return false;
+    mtime = time.time_since_epoch().count();
+    return true;
+}
+
+uint64_t align_up(uint64_t pos){
+    return (pos + 63) & ~uint64_t(63);
+}
+
+int link_blocks(){
+    return (graph.N + LINK_BLOCK - 1) / LINK_BLOCK;
+}
+
+// The graph must be on the heap at this point; an old mapping of the cache is
+// dropped before the file is overwritten.
+bool save_graph_cache(){
+    cout << "Saving graph cache..." << endl;
+    graph_file.close();
+
+    CsrHeader header = {};
+    memcpy(header.magic, CSR_MAGIC, sizeof(CSR_MAGIC));
+    header.version = CSR_VERSION;
+    header.headerSize = sizeof(CsrHeader);
+    header.ordering = graph.ordering;
+    header.encoding = graph.encoding;
+    header.numNodes = graph.N;
+    header.numEdges = graph.E;
+    if(!source_stamp(header.sourceSize, header.sourceMtime)) return false;
+
+    const bool gaps = graph.encoding == 1;
+    const unsigned long long* offsets = gaps ? graph.block_offsets : graph.in_offsets;
+    const char* links = gaps ? graph.links : reinterpret_cast<const char*>(graph.in_neighbours);
+    uint64_t offsets_bytes = ((gaps ? link_blocks() : graph.N) + 1) * sizeof(unsigned long long);
+    uint64_t links_bytes = gaps ? graph.block_offsets[link_blocks()] : graph.E * sizeof(int);
+
+    header.offsetsPos = align_up(sizeof(CsrHeader));
+    header.neighboursPos = align_up(header.offsetsPos + offsets_bytes);
+    header.outDegreePos = align_up(header.neighboursPos + links_bytes);
+    header.denseToRealPos = align_up(header.outDegreePos + graph.N * sizeof(int));
+    header.checksum = fnv1a(&header, offsetof(CsrHeader, checksum));
+
+    ofstream out(GRAPH_CACHE_FILE, ios::binary);
+    if(!out.is_open()) return false;
+
+    auto write_at = [&out](uint64_t pos, const void* data, uint64_t len){
+        static const char zeros[64] = {};
+        out.write(zeros, pos - (uint64_t)out.tellp());
+        out.write(static_cast<const char*>(data), len);
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_at(header.offsetsPos, offsets, offsets_bytes);
+    write_at(header.neighboursPos, links, links_bytes);
+    write_at(header.outDegreePos, graph.out_degree, graph.N * sizeof(int));
+    write_at(header.denseToRealPos, graph.dense_to_real, graph.N * sizeof(int));
+    out.close();
+
+    return !out.fail();
+}
+
+// With check_source false a cache older than pagelinks.csv is still used;
+// --incremental treats the cache as the previous graph by definition.
+bool load_graph_cache(bool check_source = true){
+    if(!graph_file.open(GRAPH_CACHE_FILE)) return false;
+
+    CsrHeader header;
+    if(graph_file.size() < sizeof(header)){
+        graph_file.close();
+        return false;
+    }
+    memcpy(&header, graph_file.data(), sizeof(header));
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    bool valid = memcmp(header.magic, CSR_MAGIC, sizeof(CSR_MAGIC)) == 0
+              && (header.version == CSR_VERSION || (header.version == 2 && header.encoding == 0))
+              && header.headerSize == sizeof(CsrHeader)
+              && header.ordering < size(NODE_ORDERS)
+              && header.encoding < size(LINK_ENCODINGS)
+              && header.checksum == fnv1a(&header, offsetof(CsrHeader, checksum))
+              && header.denseToRealPos + header.numNodes * sizeof(int) <= graph_file.size();
+
+    if(!valid){
+        cout << "Graph cache is invalid, rebuilding." << endl;
+        graph_file.close();
+        return false;
+    }
+    if(check_source && source_stamp(source_size, source_mtime) && (source_size != header.sourceSize || source_mtime != header.sourceMtime)){
+        cout << "Graph cache is older than " << PAGELINKS_FILE << ", rebuilding." << endl;
+        graph_file.close();
+        return false;
+    }
+
+    graph_file.willNeed();
+    const char* base = graph_file.data();
+    graph.ordering = header.ordering;
+    graph.encoding = header.encoding;
+    graph.N = header.numNodes;
+    graph.E = header.numEdges;
+    const unsigned long long* offsets = reinterpret_cast<const unsigned long long*>(base + header.offsetsPos);
+    if(graph.encoding == 1){
+        graph.in_offsets = nullptr;
+        graph.in_neighbours = nullptr;
+        graph.block_offsets = offsets;
+        graph.links = base + header.neighboursPos;
+    }
+    else{
+        graph.in_offsets = offsets;
+        graph.in_neighbours = reinterpret_cast<const int*>(base + header.neighboursPos);
+        graph.block_offsets = nullptr;
+        graph.links = nullptr;
+    }
+    graph.out_degree = reinterpret_cast<const int*>(base + header.outDegreePos);
+    graph.dense_to_real = reinterpret_cast<const int*>(base + header.denseToRealPos);
+    return true;
+}
 
+// read_varint with the common one and two byte gaps unrolled; this is the
+// inner loop of every sweep over gap coded links.
+inline uint32_t read_link_varint(const char*& p){
+    uint32_t byte = static_cast<uint8_t>(*p++);
+    if(byte < 0x80) return byte;
+    uint32_t value = byte & 0x7F;
+    byte = static_cast<uint8_t>(*p++);
+    value |= (byte & 0x7F) << 7;
+    if(byte < 0x80) return value;
+    for(int shift = 14; ; shift += 7){
+        byte = static_cast<uint8_t>(*p++);
+        value |= (byte & 0x7F) << shift;
+        if(byte < 0x80) return value;
+    }
+}
+
+// Reads the in-link lists of consecutive nodes, starting at `first`, in either
+// encoding. With gaps, `first` must start a block.
+struct InLinkReader{
+    unsigned long long e = 0;
+    const char* p = nullptr;
+
+    explicit InLinkReader(int first){
+        if(graph.encoding == 1) p = graph.links + graph.block_offsets[first / LINK_BLOCK];
+        else e = graph.in_offsets[first];
+    }
+
+    // Calls visit(u) for every in-neighbour u of v. v is the node after the
+    // one of the previous call.
+    template<typename F>
+    void row(int v, F&& visit){
+        if(p == nullptr){
+            for(const unsigned long long end = graph.in_offsets[v + 1]; e < end; e++) visit(graph.in_neighbours[e]);
+            return;
         }
-        catch(exception &e){
-            cout << "Error (First Pass): " << e.what() << endl;
-            continue;
+        uint32_t degree = read_link_varint(p);
+        if(degree == 0) return;
+        uint32_t first = read_link_varint(p);
+        int u = v + static_cast<int>((first & 1) ? ~(first >> 1) : (first >> 1));
+        visit(u);
+        for(uint32_t k = 1; k < degree; k++){
+            u += static_cast<int>(read_link_varint(p));
+            visit(u);
         }
+    }
+};
+
+vector<unsigned long long> encoded_blocks;
+string encoded_links;
+vector<unsigned long long> decoded_offsets;
+vector<int> decoded_neighbours;
 
-        line_count++;
-        if(line_count % 5000000 == 0){
-            cout << "Scanned " << line_count << " lines...\r" << flush;
+// Gap codes the in-link lists into the heap and points the graph at them.
+void encode_links(){
+    cout << "Encoding in-links as gaps..." << endl;
+    const int N = graph.N;
+    vector<unsigned long long> blocks(link_blocks() + 1, 0);
+    string links;
+    links.reserve(graph.E * 2);
+    vector<int> row;
+    InLinkReader reader(0);
+    for(int v=0; v<N; v++){
+        if(v % LINK_BLOCK == 0) blocks[v / LINK_BLOCK] = links.size();
+        row.clear();
+        reader.row(v, [&row](int u){ row.push_back(u); });
+        sort(row.begin(), row.end());
+
+        write_varint(links, row.size());
+        for(size_t k=0; k<row.size(); k++){
+            if(k == 0){
+                long long delta = static_cast<long long>(row[0]) - v;
+                write_varint(links, delta >= 0 ? uint64_t(delta) << 1 : (uint64_t(~delta) << 1) | 1);
+            }
+            else write_varint(links, row[k] - row[k - 1]);
         }
     }
+    blocks.back() = links.size();
+    encoded_blocks.swap(blocks);
+    encoded_links.swap(links);
 
-    infile.close();
-    int N = real_to_dense.size();
-    cout << "\nTotal unique nodes: " << N << endl;
-    return N;
+    double raw_mb = ((N + 1) * sizeof(unsigned long long) + graph.E * sizeof(int)) / 1048576.0;
+    double gaps_mb = (encoded_blocks.size() * sizeof(unsigned long long) + encoded_links.size()) / 1048576.0;
+    cout << "In-links: " << fixed << setprecision(1) << raw_mb << " MB raw, " << gaps_mb << " MB as gaps ("
+         << setprecision(2) << 8.0 * encoded_links.size() / max(1LL, graph.E) << " bits per link)." << defaultfloat << setprecision(6) << endl;
+
+    graph.encoding = 1;
+    graph.in_offsets = nullptr;
+    graph.in_neighbours = nullptr;
+    graph.block_offsets = encoded_blocks.data();
+    graph.links = encoded_links.data();
 }
 
+// Decodes gap coded in-links back into plain CSR arrays on the heap, for the
+// code that needs random access to rows (reordering, incremental updates,
+// topics and link signals). A no-op on a raw graph.
+void decode_links(){
+    if(graph.encoding == 0) return;
+    cout << "Decoding gap coded in-links..." << endl;
+    const int N = graph.N;
+    vector<unsigned long long> offsets(N + 1, 0);
+    vector<int> neighbours;
+    neighbours.reserve(graph.E);
+    InLinkReader reader(0);
+    for(int v=0; v<N; v++){
+        reader.row(v, [&neighbours](int u){ neighbours.push_back(u); });
+        offsets[v + 1] = neighbours.size();
+    }
+    decoded_offsets.swap(offsets);
+    decoded_neighbours.swap(neighbours);
 
-void build_graph_pass_two(int N){
-    cout << "Pass 2: Building Adjacency List..." << endl;
+    graph.encoding = 0;
+    graph.in_offsets = decoded_offsets.data();
+    graph.in_neighbours = decoded_neighbours.data();
+    graph.block_offsets = nullptr;
+    graph.links = nullptr;
+}
 
-    cout << "Reserving memory for vectors..." << endl;
-    
-    inLinks_graph.resize(N);
+// Copies the per-node arrays out of the mapped cache, so the cache can be
+// rewritten after only the links were re-encoded.
+void detach_node_arrays(){
+    if(graph.out_degree != out_degree.data()){
+        out_degree.assign(graph.out_degree, graph.out_degree + graph.N);
+        graph.out_degree = out_degree.data();
+    }
+    if(graph.dense_to_real != dense_to_real.data()){
+        dense_to_real.assign(graph.dense_to_real, graph.dense_to_real + graph.N);
+        graph.dense_to_real = dense_to_real.data();
+    }
+}
 
-    for(int i=0; i<N; i++){
-        if(in_degree[i] > 0){
-            inLinks_graph[i].reserve(in_degree[i]);
+// Out-link adjacency, built by transposing the in-link CSR.
+struct OutLinks{
+    vector<unsigned long long> offsets;
+    vector<int> neighbours;
+};
+
+OutLinks transpose_graph(){
+    OutLinks out;
+    out.offsets.assign(graph.N + 1, 0);
+    for(int u=0; u<graph.N; u++){
+        out.offsets[u + 1] = out.offsets[u] + graph.out_degree[u];
+    }
+    out.neighbours.resize(out.offsets[graph.N]);
+
+    vector<unsigned long long> cursor(out.offsets.begin(), out.offsets.end() - 1);
+    for(int v=0; v<graph.N; v++){
+        for(unsigned long long e = graph.in_offsets[v]; e < graph.in_offsets[v + 1]; e++){
+            out.neighbours[cursor[graph.in_neighbours[e]]++] = v;
         }
     }
+    return out;
+}
 
-    vector<int>().swap(in_degree);
-    cout << "  Memory ready. Filling graph..." << endl;
+// The pull loop reads contrib[j] once per out-link of j, so putting the nodes
+// with the most out-links first packs the hottest entries into a few cache lines.
+vector<int> degree_order(){
+    vector<int> order(graph.N);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [](int a, int b){
+        return graph.out_degree[a] > graph.out_degree[b];
+    });
+    return order;
+}
+
+// Reverse Cuthill-McKee on the undirected view of the graph: breadth-first
+// from low-degree nodes, visiting neighbours by increasing degree, then
+// reversed. Linked pages end up with nearby ids, so the in-neighbours of a
+// node tend to share cache lines.
+vector<int> rcm_order(){
+    const int N = graph.N;
+    OutLinks out = transpose_graph();
 
-    ifstream infile(PAGELINKS_FILE);
-    if(!infile.is_open()){
-        cerr << "Error: Pagelinks not opening in Pass 2" << endl;
-        exit(1) ;
+    vector<long long> degree(N);
+    for(int v=0; v<N; v++){
+        degree[v] = (graph.in_offsets[v + 1] - graph.in_offsets[v]) + graph.out_degree[v];
     }
 
-    string line;
-    int u_real, v_real;
-    long long line_count = 0;
+    vector<int> by_degree(N);
+    iota(by_degree.begin(), by_degree.end(), 0);
+    stable_sort(by_degree.begin(), by_degree.end(), [&degree](int a, int b){
+        return degree[a] < degree[b];
+    });
 
-    while(getline(infile, line)){
-        size_t comma_pos = line.find(',');
-        if(comma_pos == string::npos) continue;
-        try{
-            u_real = stoi(line.substr(0, comma_pos));
-            v_real = stoi(line.substr(comma_pos + 1));
+    vector<char> visited(N, 0);
+    vector<int> order;
+    order.reserve(N);
+    vector<int> next;
 
-            if((valid_pageids.find(u_real) == valid_pageids.end()) || (valid_pageids.find(v_real) == valid_pageids.end())){
-                continue;
+    for(int start : by_degree){
+        if(visited[start]) continue;
+        visited[start] = 1;
+        order.push_back(start);
+
+        for(size_t head = order.size() - 1; head < order.size(); head++){
+            int v = order[head];
+            next.clear();
+            for(unsigned long long e = graph.in_offsets[v]; e < graph.in_offsets[v + 1]; e++){
+                int u = graph.in_neighbours[e];
+                if(!visited[u]){ visited[u] = 1; next.push_back(u); }
+            }
+            for(unsigned long long e = out.offsets[v]; e < out.offsets[v + 1]; e++){
+                int u = out.neighbours[e];
+                if(!visited[u]){ visited[u] = 1; next.push_back(u); }
             }
+            stable_sort(next.begin(), next.end(), [&degree](int a, int b){
+                return degree[a] < degree[b];
+            });
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
 
-            int u_dense = real_to_dense[u_real];
-            int v_dense = real_to_dense[v_real];
-            
-            inLinks_graph[v_dense].push_back(u_dense);
+    reverse(order.begin(), order.end());
+    return order;
+}
 
+vector<unsigned long long> ordered_offsets;
+vector<int> ordered_neighbours;
+vector<int> ordered_out_degree;
+vector<int> ordered_dense_to_real;
+
+// Renumbers the graph so that new node v is old node order[v]. The renumbered
+// copy lives on the heap until it is written back to the cache.
+void apply_order(const vector<int>& order, uint32_t ordering){
+    const int N = graph.N;
+    vector<int> rank(N);
+    for(int v=0; v<N; v++) rank[order[v]] = v;
+
+    ordered_offsets.assign(N + 1, 0);
+    ordered_neighbours.resize(graph.E);
+    ordered_out_degree.resize(N);
+    ordered_dense_to_real.resize(N);
+
+    for(int v=0; v<N; v++){
+        int old = order[v];
+        unsigned long long begin = graph.in_offsets[old], end = graph.in_offsets[old + 1];
+        unsigned long long pos = ordered_offsets[v];
+        for(unsigned long long e = begin; e < end; e++){
+            ordered_neighbours[pos++] = rank[graph.in_neighbours[e]];
         }
-        catch(exception &e){
-            cout << "Error (Second Pass): " << e.what() << endl;
-            continue;
-        }
+        sort(ordered_neighbours.begin() + ordered_offsets[v], ordered_neighbours.begin() + pos);
+        ordered_offsets[v + 1] = pos;
+        ordered_out_degree[v] = graph.out_degree[old];
+        ordered_dense_to_real[v] = graph.dense_to_real[old];
+    }
+
+    graph.in_offsets = ordered_offsets.data();
+    graph.in_neighbours = ordered_neighbours.data();
+    graph.out_degree = ordered_out_degree.data();
+    graph.dense_to_real = ordered_dense_to_real.data();
+    graph.ordering = ordering;
+}
+
+void release_build_arrays(){
+    vector<unsigned long long>().swap(in_offsets);
+    vector<int>().swap(in_neighbours);
+    vector<int>().swap(out_degree);
+    vector<int>().swap(dense_to_real);
+    vector<unsigned long long>().swap(ordered_offsets);
+    vector<int>().swap(ordered_neighbours);
+    vector<int>().swap(ordered_out_degree);
+    vector<int>().swap(ordered_dense_to_real);
+    vector<unsigned long long>().swap(encoded_blocks);
+    string().swap(encoded_links);
+    vector<unsigned long long>().swap(decoded_offsets);
+    vector<int>().swap(decoded_neighbours);
+}
 
-        line_count++;
-        if(line_count % 5000000 == 0){
-            cout << "Loaded " << line_count << " edges...\r" << flush;
+// Splits the destination nodes into `parts` contiguous ranges with roughly
+// equal work, counting one unit per node and one per in-edge. Range p is
+// [bounds[p], bounds[p+1]). Sweeps over the out-links pass their own offsets.
+// Gap coded in-links are split on block boundaries, with a unit per byte.
+vector<int> partition_nodes(unsigned parts, const unsigned long long* offsets = nullptr){
+    if(offsets == nullptr && graph.encoding == 1){
+        const int B = link_blocks();
+        const unsigned long long total = graph.block_offsets[B] + graph.N;
+        vector<int> bounds(parts + 1, graph.N);
+        bounds[0] = 0;
+        int previous = 0;
+        for(unsigned p=1; p<parts; p++){
+            unsigned long long target = total * p / parts;
+            int lo = previous, hi = B;
+            while(lo < hi){
+                int mid = lo + (hi - lo) / 2;
+                if(graph.block_offsets[mid] + (unsigned long long)mid * LINK_BLOCK < target) lo = mid + 1;
+                else hi = mid;
+            }
+            previous = lo;
+            bounds[p] = min(graph.N, lo * LINK_BLOCK);
+        }
+        return bounds;
+    }
+    if(offsets == nullptr) offsets = graph.in_offsets;
+    const unsigned long long total = graph.E + graph.N;
+    vector<int> bounds(parts + 1, graph.N);
+    bounds[0] = 0;
+    for(unsigned p=1; p<parts; p++){
+        unsigned long long target = total * p / parts;
+        int lo = bounds[p - 1], hi = graph.N;
+        while(lo < hi){
+            int mid = lo + (hi - lo) / 2;
+            if(offsets[mid] + mid < target) lo = mid + 1;
+            else hi = mid;
         }
+        bounds[p] = lo;
     }
+    return bounds;
+}
 
-    infile.close();
+// Sum of per-part values, always added in part order.
+double reduce_parts(const vector<double>& partial){
+    double total = 0.0;
+    for(double v : partial) total += v;
+    return total;
+}
 
-    real_to_dense.clear();
-    cout << "\nGraph Loaded." << endl;
+// Scales x to sum to 1, clamping any negative entries an extrapolation step
+// may have produced.
+void normalize_scores(ThreadPool& pool, const vector<int>& bounds, vector<double>& x){
+    const unsigned parts = bounds.size() - 1;
+    vector<double> partial(parts);
+    pool.parallelFor(parts, [&](unsigned p){
+        double sum = 0.0;
+        for(int i = bounds[p]; i < bounds[p + 1]; i++){
+            x[i] = max(x[i], 0.0);
+            sum += x[i];
+        }
+        partial[p] = sum;
+    });
+    double total = reduce_parts(partial);
+    if(total <= 0) return;
+    pool.parallelFor(parts, [&](unsigned p){
+        for(int i = bounds[p]; i < bounds[p + 1]; i++) x[i] /= total;
+    });
 }
 
-vector<double> run_pagerank(int N){
-    cout << "Calculating pagerank..." << endl;
-    if(N<=0) return{};
+// Aitken delta-squared, componentwise on the iterates x2, x1, x (oldest first).
+void aitken_extrapolate(ThreadPool& pool, const vector<int>& bounds, vector<double>& x,
+                        const vector<double>& x1, const vector<double>& x2){
+    pool.parallelFor(bounds.size() - 1, [&](unsigned p){
+        for(int i = bounds[p]; i < bounds[p + 1]; i++){
+            double d1 = x[i] - x1[i];
+            double d2 = x[i] - 2.0 * x1[i] + x2[i];
+            if(std::abs(d2) > 1e-30){
+                double extrapolated = x[i] - d1 * d1 / d2;
+                if(extrapolated > 0) x[i] = extrapolated;
+            }
+        }
+    });
+    normalize_scores(pool, bounds, x);
+}
 
-    vector<double> scores(N, 1.0/N);
-    vector<double> new_scores(N, 0.0);
+// Quadratic extrapolation (Kamvar et al.) on the iterates x3, x2, x1, x (oldest
+// first). Fits the two-term least squares problem on the differences to x3 and
+// replaces x with the resulting combination of x2, x1 and x.
+void quadratic_extrapolate(ThreadPool& pool, const vector<int>& bounds, vector<double>& x,
+                           const vector<double>& x1, const vector<double>& x2, const vector<double>& x3){
+    const unsigned parts = bounds.size() - 1;
+    // Per part: y0.y0, y0.y1, y1.y1, y0.y2, y1.y2
+    vector<vector<double>> partial(5, vector<double>(parts));
+    pool.parallelFor(parts, [&](unsigned p){
+        double a = 0, b = 0, c = 0, r0 = 0, r1 = 0;
+        for(int i = bounds[p]; i < bounds[p + 1]; i++){
+            double y0 = x2[i] - x3[i];
+            double y1 = x1[i] - x3[i];
+            double y2 = x[i] - x3[i];
+            a += y0 * y0;
+            b += y0 * y1;
+            c += y1 * y1;
+            r0 += y0 * y2;
+            r1 += y1 * y2;
+        }
+        partial[0][p] = a;
+        partial[1][p] = b;
+        partial[2][p] = c;
+        partial[3][p] = r0;
+        partial[4][p] = r1;
+    });
+    double a = reduce_parts(partial[0]), b = reduce_parts(partial[1]), c = reduce_parts(partial[2]);
+    double r0 = reduce_parts(partial[3]), r1 = reduce_parts(partial[4]);
 
-    const double tolerance = 1e-12;
+    double det = a * c - b * b;
+    if(std::abs(det) <= 1e-12 * a * c) return;
+    double g1 = (-r0 * c + r1 * b) / det;
+    double g2 = (-r1 * a + r0 * b) / det;
 
-    for(int iteration = 0; iteration < NUM_ITERATIONS; iteration++){
-        double diff = 0.0;
+    const double beta0 = g1 + g2 + 1.0;
+    const double beta1 = g2 + 1.0;
+    const double beta2 = 1.0;
+    pool.parallelFor(parts, [&](unsigned p){
+        for(int i = bounds[p]; i < bounds[p + 1]; i++){
+            x[i] = beta0 * x2[i] + beta1 * x1[i] + beta2 * x[i];
+        }
+    });
+    normalize_scores(pool, bounds, x);
+}
 
-        double sink_mass = 0.0;
-        for(int j=0; j<N; ++j){
-            if(out_degree[j] == 0) sink_mass += scores[j];
+// Pull-based PageRank. Each part owns a range of destination nodes and writes
+// only its own slice, so no locking is needed. The sink mass and the residual
+// are reduced per part and summed in part order, which keeps the result
+// bit-identical across runs with the same thread count.
+//
+// Solvers:
+//   jacobi        power iteration, every node reads the previous iterate
+//   gauss-seidel  in place on the equivalent linear system (I - dA) y = (1-d)/N,
+//                 where A leaves out the sink columns and y is normalised at
+//                 the end. Dropping the sink term keeps the sweep free of the
+//                 mass error that slows in-place updates down. A node reads the
+//                 updated values of earlier nodes in its own range and the
+//                 previous iterate elsewhere
+//   aitken        jacobi with Aitken delta-squared every EXTRAPOLATION_PERIOD
+//   quadratic     jacobi with quadratic extrapolation every EXTRAPOLATION_PERIOD
+// Iteration stops once the L1 change of one sweep is below the tolerance.
+// `initial` (normalised, one entry per node) warm-starts the iteration;
+// empty means the uniform vector.
+vector<double> run_pagerank(vector<double> initial = {}){
+    cout << "Calculating pagerank (" << solver << ") on " << num_threads << " threads..." << endl;
+    const int N = graph.N;
+    if(N<=0) return{};
+
+    ThreadPool pool(num_threads);
+    const unsigned parts = num_threads;
+    const vector<int> bounds = partition_nodes(parts);
+
+    const bool gauss_seidel = (solver == "gauss-seidel");
+    const int history_needed = (solver == "aitken") ? 2 : (solver == "quadratic") ? 3 : 0;
+
+    vector<double> scores(N, 1.0/N);
+    if(!initial.empty()){
+        scores.swap(initial);
+        // The gauss-seidel iterate is unnormalised: y = (1-d) / (1-d + d * sink mass) * x.
+        if(gauss_seidel){
+            double sink_mass = 0.0;
+            for(int j=0; j<N; j++){
+                if(graph.out_degree[j] == 0) sink_mass += scores[j];
+            }
+            double scale = (1.0 - damping_factor) / (1.0 - damping_factor + damping_factor * sink_mass);
+            for(auto& v : scores) v *= scale;
         }
-      
-        const double teleport = (1.0 - DAMPING_FACTOR) / static_cast<double>(N);
-        const double sink_contrib = DAMPING_FACTOR * sink_mass / static_cast<double>(N);
+    }
+    vector<double> new_scores(gauss_seidel ? 0 : N, 0.0);
+    // scores[j] / out_degree[j], computed once per iteration instead of once per edge.
+    vector<double> contrib(N, 0.0);
+    // Gauss-Seidel: contributions updated in place within each part's range.
+    vector<double> live_contrib(gauss_seidel ? N : 0, 0.0);
+    // Previous iterates for extrapolation, newest first.
+    vector<vector<double>> history(history_needed, vector<double>(N, 0.0));
+    int history_size = 0;
+    vector<double> partial_sink(parts), partial_diff(parts), partial_mass(parts, 1.0 / parts);
 
-        for(int i=0; i<N; i++){
-            double sum = 0.0;
+    auto iteration_start_time = chrono::high_resolution_clock::now();
+    double residual = 0.0;
+    int iterations_done = 0;
 
-            for(int j : inLinks_graph[i]){
-                int od = out_degree[j];
-                if(od > 0){
-                    sum += scores[j] / static_cast<double>(od);
+    for(int iteration = 0; iteration < num_iterations; iteration++){
+
+        pool.parallelFor(parts, [&](unsigned p){
+            double sink = 0.0;
+            for(int j = bounds[p]; j < bounds[p + 1]; j++){
+                int od = graph.out_degree[j];
+                if(od > 0) contrib[j] = scores[j] / static_cast<double>(od);
+                else{
+                    contrib[j] = 0.0;
+                    sink += scores[j];
                 }
+                if(gauss_seidel) live_contrib[j] = contrib[j];
             }
-            new_scores[i] = teleport + DAMPING_FACTOR * sum + sink_contrib;
-            diff += std::abs(new_scores[i] - scores[i]);
+            partial_sink[p] = sink;
+        });
+
+        const double sink_mass = reduce_parts(partial_sink);
+        const double teleport = (1.0 - damping_factor) / static_cast<double>(N);
+        const double sink_contrib = gauss_seidel ? 0.0 : damping_factor * sink_mass / static_cast<double>(N);
+
+        if(gauss_seidel){
+            pool.parallelFor(parts, [&](unsigned p){
+                const int lo = bounds[p], hi = bounds[p + 1];
+                double diff = 0.0, mass = 0.0;
+                InLinkReader reader(lo);
+                for(int i = lo; i < hi; i++){
+                    double sum = 0.0;
+                    reader.row(i, [&](int j){
+                        sum += (j >= lo && j < hi) ? live_contrib[j] : contrib[j];
+                    });
+                    double updated = teleport + damping_factor * sum + sink_contrib;
+                    diff += std::abs(updated - scores[i]);
+                    mass += updated;
+                    scores[i] = updated;
+                    int od = graph.out_degree[i];
+                    if(od > 0) live_contrib[i] = updated / static_cast<double>(od);
+                }
+                partial_diff[p] = diff;
+                partial_mass[p] = mass;
+            });
         }
+        else{
+            pool.parallelFor(parts, [&](unsigned p){
+                double diff = 0.0;
+                InLinkReader reader(bounds[p]);
+                for(int i = bounds[p]; i < bounds[p + 1]; i++){
+                    double sum = 0.0;
+                    reader.row(i, [&](int j){ sum += contrib[j]; });
+                    new_scores[i] = teleport + damping_factor * sum + sink_contrib;
+                    diff += std::abs(new_scores[i] - scores[i]);
+                }
+                partial_diff[p] = diff;
+            });
 
-        scores.swap(new_scores);
-        std::fill(new_scores.begin(), new_scores.end(), 0.0);
+            // Rotate buffers: scores becomes the newest history entry.
+            if(history_needed > 0){
+                for(int h = history_needed - 1; h > 0; h--) history[h].swap(history[h - 1]);
+                history[0].swap(scores);
+                history_size = min(history_size + 1, history_needed);
+            }
+            scores.swap(new_scores);
+        }
 
-        double avg_diff = diff / static_cast<double>(N);
-        cout << "Iteration " << (iteration + 1) << " done. Avg Diff: " << avg_diff << "\r" << flush;
+        // Relative to the total so the gauss-seidel residual is on the same scale.
+        residual = reduce_parts(partial_diff) / reduce_parts(partial_mass);
+        iterations_done = iteration + 1;
+        cout << "Iteration " << iterations_done << " done. L1 residual: " << residual << "\r" << flush;
 
-        if (avg_diff < tolerance) {
-            cout << "\nConverged in " << (iteration + 1) << " iterations.\n";
+        if(residual < tolerance){
+            cout << "\nConverged in " << iterations_done << " iterations.\n";
             break;
         }
         cout << endl;
 
+        if(history_size == history_needed && history_needed > 0 && iterations_done % EXTRAPOLATION_PERIOD == 0){
+            if(solver == "aitken") aitken_extrapolate(pool, bounds, scores, history[0], history[1]);
+            else quadratic_extrapolate(pool, bounds, scores, history[0], history[1], history[2]);
+            history_size = 0;
+        }
     }
+
+    auto iteration_duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - iteration_start_time);
+    cout << "Solver: " << solver << ", iterations: " << iterations_done << ", L1 residual: " << residual
+         << ", iteration time: " << iteration_duration.count() / 1000.0 << " sec." << endl;
+
     double s = 0.0;
     for(auto sc : scores){
         s += sc;
@@ -243,6 +988,771 @@ vector<double> run_pagerank(int N){
     return scores;
 }
 
+// Incremental update (--incremental delta.csv).
+//
+// The mapped cache is the previous graph and pagerank_scores.csv (or
+// --previous) its converged scores. The delta file lists link changes in
+// real page ids, one per line:
+//   +u,v    link u -> v added
+//   -u,v    link u -> v removed
+// Pages that are new to the graph become new nodes at the end of the
+// numbering. When the delta is small (at most PUSH_MAX_EDIT_FRACTION of the
+// edges) the change is first pushed out from the affected pages; whatever the
+// pushes leave unsettled is finished by the solver, warm-started from the
+// repaired (or, for large deltas, the previous) scores.
+
+const double PUSH_MAX_EDIT_FRACTION = 0.01;
+// Push work, in graph sizes (edges + nodes), after which the local update hands
+// over to the solver. A push costs several times a solver sweep per edge.
+const double PUSH_MAX_WORK_FACTOR = 0.5;
+const double PUSH_THRESHOLD_STEP = 4.0;
+
+struct LinkDelta{
+    vector<pair<int,int>> added;      // (v_dense, u_dense)
+    vector<pair<int,int>> removed;    // (v_dense, u_dense)
+};
+
+// Fills id_table with the dense id of every page already in the graph, on top
+// of the valid-page flags from doc_info.jsonl.
+void map_existing_nodes(){
+    int max_real = id_table.empty() ? -1 : (int)id_table.size() - 1;
+    for(int v=0; v<graph.N; v++) max_real = max(max_real, graph.dense_to_real[v]);
+    id_table.resize(max_real + 1, NOT_A_PAGE);
+
+    dense_to_real.assign(graph.dense_to_real, graph.dense_to_real + graph.N);
+    for(int v=0; v<graph.N; v++) id_table[graph.dense_to_real[v]] = v;
+}
+
+bool read_link_delta(const string& path, LinkDelta& delta){
+    ifstream in(path);
+    if(!in.is_open()) return false;
+
+    string line;
+    long long skipped = 0;
+    const int table_size = id_table.size();
+    while(getline(in, line)){
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty() || line[0] == '#') continue;
+
+        const bool add = (line[0] == '+');
+        const char* p = line.data() + 1;
+        const char* end = line.data() + line.size();
+        int u_real, v_real;
+        bool ok = (add || line[0] == '-') && parse_int(p, end, u_real) && p < end && *p++ == ',' && parse_int(p, end, v_real) && p == end
+               && u_real < table_size && v_real < table_size && id_table[u_real] != NOT_A_PAGE && id_table[v_real] != NOT_A_PAGE;
+        // A removed link between pages the graph has never seen cannot exist.
+        if(ok && !add && (id_table[u_real] == UNSEEN_PAGE || id_table[v_real] == UNSEEN_PAGE)) ok = false;
+        if(!ok){
+            skipped++;
+            continue;
+        }
+
+        for(int real : {u_real, v_real}){
+            if(id_table[real] == UNSEEN_PAGE){
+                id_table[real] = dense_to_real.size();
+                dense_to_real.push_back(real);
+            }
+        }
+        (add ? delta.added : delta.removed).push_back({id_table[v_real], id_table[u_real]});
+    }
+
+    cout << "Delta: " << delta.added.size() << " links added, " << delta.removed.size() << " removed, "
+         << dense_to_real.size() - graph.N << " new pages";
+    if(skipped > 0) cout << ", " << skipped << " lines skipped";
+    cout << endl;
+    return true;
+}
+
+// Previous scores by dense id of the current graph; pages missing from the
+// file get 0.
+bool read_previous_scores(const string& path, vector<double>& scores){
+    MappedFile file;
+    if(!file.open(path)) return false;
+
+    scores.assign(graph.N, 0.0);
+    const char* p = file.data();
+    const char* end = p + file.size();
+    const int table_size = id_table.size();
+    while(p < end){
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if(line_end == nullptr) line_end = end;
+
+        int real;
+        double score;
+        const char* q = p;
+        if(parse_int(q, line_end, real) && q < line_end && *q++ == ','){
+            auto [next, ec] = from_chars(q, line_end, score);
+            if(ec == errc() && real < table_size && id_table[real] >= 0 && id_table[real] < graph.N){
+                scores[id_table[real]] = score;
+            }
+        }
+        p = line_end + 1;
+    }
+    return true;
+}
+
+// Rebuilds the in-link CSR with the delta applied into the build vectors and
+// points the graph at them. row_changed marks nodes whose in-links changed and
+// degree_changed nodes whose out-degree changed.
+void apply_link_delta(LinkDelta& delta, vector<char>& row_changed, vector<char>& degree_changed){
+    const int old_N = graph.N;
+    const int N = dense_to_real.size();
+    sort(delta.added.begin(), delta.added.end());
+    sort(delta.removed.begin(), delta.removed.end());
+
+    out_degree.assign(N, 0);
+    copy(graph.out_degree, graph.out_degree + old_N, out_degree.begin());
+    row_changed.assign(N, 0);
+    degree_changed.assign(N, 0);
+
+    in_offsets.assign(N + 1, 0);
+    in_neighbours.clear();
+    in_neighbours.reserve(graph.E + delta.added.size());
+
+    long long missing = 0;
+    size_t a = 0, r = 0;
+    vector<int> row;
+    for(int v=0; v<N; v++){
+        row.clear();
+        if(v < old_N){
+            row.assign(graph.in_neighbours + graph.in_offsets[v], graph.in_neighbours + graph.in_offsets[v + 1]);
+        }
+
+        for(; r < delta.removed.size() && delta.removed[r].first == v; r++){
+            int u = delta.removed[r].second;
+            auto it = find(row.begin(), row.end(), u);
+            if(it == row.end()){
+                missing++;
+                continue;
+            }
+            row.erase(it);
+            out_degree[u]--;
+            degree_changed[u] = 1;
+            row_changed[v] = 1;
+        }
+        for(; a < delta.added.size() && delta.added[a].first == v; a++){
+            int u = delta.added[a].second;
+            row.push_back(u);
+            out_degree[u]++;
+            degree_changed[u] = 1;
+            row_changed[v] = 1;
+        }
+
+        in_neighbours.insert(in_neighbours.end(), row.begin(), row.end());
+        in_offsets[v + 1] = in_neighbours.size();
+    }
+    if(missing > 0) cout << "Warning: " << missing << " removed links were not in the graph" << endl;
+
+    graph.N = N;
+    graph.E = in_neighbours.size();
+    graph.in_offsets = in_offsets.data();
+    graph.in_neighbours = in_neighbours.data();
+    graph.out_degree = out_degree.data();
+    graph.dense_to_real = dense_to_real.data();
+}
+
+// Local repair on the linear system y = (1-d)/N + d A y (A without sink
+// columns, PageRank = y / |y|). The previous solution is exact for every node
+// whose equation did not change, so only the affected nodes start with a
+// residual. Pushing node u moves its residual into y[u] and spreads
+// d * r[u] / out_degree(u) to its out-links.
+//
+// An L1 target cannot be met by pushing only large residuals once the change
+// has spread through a well-connected graph, so the push threshold starts at
+// the target and is lowered by PUSH_THRESHOLD_STEP until the summed residual is
+// below it. Returns false if the work limit is hit first; `result` then holds
+// the partly repaired scores as a starting point for the solver.
+bool push_update(const vector<double>& previous, int old_N, double old_sink_mass,
+                 const vector<char>& row_changed, const vector<char>& degree_changed, vector<double>& result){
+    const int N = graph.N;
+    const double d = damping_factor;
+    const double b = (1.0 - d) / N;
+
+    // Previous normalised scores -> previous y, rescaled from b = (1-d)/old_N to (1-d)/N.
+    const double scale = (1.0 - d) / (1.0 - d + d * old_sink_mass) * old_N / N;
+    vector<double> y(N, 0.0);
+    for(int v=0; v<old_N; v++) y[v] = previous[v] * scale;
+
+    OutLinks out = transpose_graph();
+
+    vector<char> affected(N, 0);
+    for(int v=0; v<N; v++){
+        if(row_changed[v] || v >= old_N) affected[v] = 1;
+        if(degree_changed[v]){
+            for(unsigned long long e = out.offsets[v]; e < out.offsets[v + 1]; e++) affected[out.neighbours[e]] = 1;
+        }
+    }
+
+    // touched lists every node that has held a residual, so the residual sum
+    // never needs a pass over the whole graph.
+    vector<double> residual(N, 0.0);
+    vector<int> touched;
+    vector<char> is_touched(N, 0);
+    for(int v=0; v<N; v++){
+        if(!affected[v]) continue;
+        double sum = 0.0;
+        for(unsigned long long e = graph.in_offsets[v]; e < graph.in_offsets[v + 1]; e++){
+            int j = graph.in_neighbours[e];
+            sum += y[j] / graph.out_degree[j];
+        }
+        residual[v] = b + d * sum - y[v];
+        touched.push_back(v);
+        is_touched[v] = 1;
+    }
+    const long long num_affected = touched.size();
+
+    double total = 0.0;
+    for(int v=0; v<N; v++) total += y[v];
+    const double target = tolerance * total;
+    const double max_work = PUSH_MAX_WORK_FACTOR * (graph.E + N);
+
+    deque<int> queue;
+    vector<char> queued(N, 0);
+    double work = 0;
+    long long pushes = 0;
+    double remaining = 0.0;
+    bool converged = false;
+
+    for(double eps = target; work <= max_work; eps /= PUSH_THRESHOLD_STEP){
+        remaining = 0.0;
+        for(int v : touched) remaining += std::abs(residual[v]);
+        if(remaining <= target){
+            converged = true;
+            break;
+        }
+
+        for(int v : touched){
+            if(std::abs(residual[v]) > eps){
+                queue.push_back(v);
+                queued[v] = 1;
+            }
+        }
+        while(!queue.empty() && work <= max_work){
+            int u = queue.front();
+            queue.pop_front();
+            queued[u] = 0;
+
+            double ru = residual[u];
+            y[u] += ru;
+            residual[u] = 0.0;
+            pushes++;
+
+            int od = graph.out_degree[u];
+            double spread = (od == 0) ? 0.0 : d * ru / od;
+            for(unsigned long long e = out.offsets[u]; e < out.offsets[u + 1]; e++){
+                int w = out.neighbours[e];
+                residual[w] += spread;
+                if(!is_touched[w]){
+                    touched.push_back(w);
+                    is_touched[w] = 1;
+                }
+                if(!queued[w] && std::abs(residual[w]) > eps){
+                    queue.push_back(w);
+                    queued[w] = 1;
+                }
+            }
+            work += od + 1;
+        }
+        for(int v : queue) queued[v] = 0;
+        queue.clear();
+    }
+
+    total = 0.0;
+    for(int v=0; v<N; v++) total += y[v];
+    cout << "Local update: " << num_affected << " affected nodes, " << pushes << " pushes, "
+         << (long long)work << " edges touched, L1 residual " << remaining / total << endl;
+    if(!converged) cout << "Local update stopped at its work limit, finishing with the solver." << endl;
+
+    result.resize(N);
+    for(int v=0; v<N; v++) result[v] = y[v] / total;
+    return converged;
+}
+
+vector<double> run_incremental(const string& delta_path, const string& previous_path){
+    auto start_time = chrono::high_resolution_clock::now();
+    decode_links();
+
+    find_valid_pageids();
+    map_existing_nodes();
+
+    LinkDelta delta;
+    if(!read_link_delta(delta_path, delta)){
+        cerr << "Error: could not open delta file " << delta_path << endl;
+        exit(1);
+    }
+
+    vector<double> previous;
+    if(!read_previous_scores(previous_path, previous)){
+        cerr << "Error: could not open previous scores " << previous_path << endl;
+        exit(1);
+    }
+    const int old_N = graph.N;
+    double old_sink_mass = 0.0;
+    for(int v=0; v<old_N; v++){
+        if(graph.out_degree[v] == 0) old_sink_mass += previous[v];
+    }
+
+    vector<char> row_changed, degree_changed;
+    apply_link_delta(delta, row_changed, degree_changed);
+    vector<int>().swap(id_table);
+    cout << "Graph updated: " << graph.N << " nodes, " << graph.E << " edges." << endl;
+
+    vector<double> scores;
+    const long long edits = delta.added.size() + delta.removed.size();
+    bool local = false;
+    if(edits <= PUSH_MAX_EDIT_FRACTION * graph.E){
+        local = push_update(previous, old_N, old_sink_mass, row_changed, degree_changed, scores);
+    }
+    else{
+        // Warm start: previous scores, new pages at the teleport value.
+        scores.assign(graph.N, (1.0 - damping_factor) / graph.N);
+        copy(previous.begin(), previous.end(), scores.begin());
+        double total = accumulate(scores.begin(), scores.end(), 0.0);
+        for(auto& v : scores) v /= total;
+    }
+    vector<double>().swap(previous);
+    if(!local) scores = run_pagerank(move(scores));
+
+    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - start_time);
+    cout << "Incremental update (" << (local ? "local push" : "solver") << "): " << duration.count() / 1000.0 << " sec." << endl;
+    return scores;
+}
+
+// Topic-sensitive (personalised) PageRank (--topics topics.txt).
+//
+// Each line of the topics file defines one vector:
+//   name: seed seed ...
+// A seed is a page id or title~text, which selects every page whose title
+// contains text (case-insensitive, '_' stands for a space). '#' starts a
+// comment line. The random jump of a vector, and the mass of its sinks, go
+// uniformly to its seeds instead of to every page.
+//
+// All vectors are iterated together: scores are stored node-major, so every
+// edge read serves all topics. The result is written to TOPICS_OUTPUT_FILE as
+// one log-quantised column per topic for search to pick at query time.
+
+const string TOPICS_OUTPUT_FILE = "pagerank_topics.bin";
+const int MAX_TOPICS = 64;
+
+struct Topic{
+    string name;
+    vector<int> page_ids;
+    vector<string> title_patterns;
+    vector<int> seeds;                // dense node ids
+};
+
+string lowercase(string text){
+    transform(text.begin(), text.end(), text.begin(), [](unsigned char c){ return tolower(c); });
+    return text;
+}
+
+bool read_topics(const string& path, vector<Topic>& topics){
+    ifstream in(path);
+    if(!in.is_open()){
+        cerr << "Error: could not open topics file " << path << endl;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+    while(getline(in, line)){
+        line_number++;
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        size_t start = line.find_first_not_of(" \t");
+        if(start == string::npos || line[start] == '#') continue;
+
+        size_t colon = line.find(':');
+        string name = (colon == string::npos) ? "" : line.substr(start, colon - start);
+        while(!name.empty() && isspace((unsigned char)name.back())) name.pop_back();
+        if(name.empty() || name.size() >= SCORE_NAME_SIZE || name.find_first_of(" \t@") != string::npos){
+            cerr << "Error: " << path << ":" << line_number << ": expected 'name: seeds', names up to "
+                 << SCORE_NAME_SIZE - 1 << " characters without spaces or '@'" << endl;
+            return false;
+        }
+
+        Topic topic;
+        topic.name = name;
+        stringstream seeds(line.substr(colon + 1));
+        string seed;
+        while(seeds >> seed){
+            int page_id;
+            const char* p = seed.data();
+            if(seed.rfind("title~", 0) == 0 && seed.size() > 6){
+                string pattern = lowercase(seed.substr(6));
+                replace(pattern.begin(), pattern.end(), '_', ' ');
+                topic.title_patterns.push_back(pattern);
+            }
+            else if(parse_int(p, seed.data() + seed.size(), page_id) && p == seed.data() + seed.size()){
+                topic.page_ids.push_back(page_id);
+            }
+            else{
+                cerr << "Error: " << path << ":" << line_number << ": bad seed '" << seed << "'" << endl;
+                return false;
+            }
+        }
+        topics.push_back(move(topic));
+    }
+
+    if(topics.empty() || topics.size() > (size_t)MAX_TOPICS){
+        cerr << "Error: " << path << " must define between 1 and " << MAX_TOPICS << " topics" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Calls visit(page_id, lowercased title) for every line of doc_info.jsonl.
+template<typename F>
+void for_each_title(F&& visit){
+    MappedFile docinfo;
+    if(!docinfo.open(DOC_INFO_PATH)){
+        cerr << "Error: Could not open docinfo";
+        exit(1);
+    }
+    docinfo.willNeed();
+
+    const char* p = docinfo.data();
+    const char* end = p + docinfo.size();
+    string title;
+    int page_id;
+    uint32_t length;
+    while(p < end){
+        const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if(line_end == nullptr) line_end = end;
+        if(parse_doc_line(string_view(p, line_end - p), page_id, title, length) && page_id >= 0){
+            visit(page_id, lowercase(title));
+        }
+        p = line_end + 1;
+    }
+}
+
+// Maps the seeds of every topic to dense node ids. Pages without links are not
+// in the graph and cannot be seeds.
+void resolve_topic_seeds(vector<Topic>& topics){
+    int max_real = 0;
+    for(int v=0; v<graph.N; v++) max_real = max(max_real, graph.dense_to_real[v]);
+    vector<int> dense_of(max_real + 1, -1);
+    for(int v=0; v<graph.N; v++) dense_of[graph.dense_to_real[v]] = v;
+    auto add_seed = [&](Topic& topic, int page_id){
+        if(page_id <= max_real && dense_of[page_id] >= 0) topic.seeds.push_back(dense_of[page_id]);
+    };
+
+    bool any_patterns = false;
+    for(auto& topic : topics){
+        for(int page_id : topic.page_ids) add_seed(topic, page_id);
+        any_patterns = any_patterns || !topic.title_patterns.empty();
+    }
+    if(any_patterns){
+        for_each_title([&](int page_id, const string& title){
+            for(auto& topic : topics){
+                for(const string& pattern : topic.title_patterns){
+                    if(title.find(pattern) != string::npos){
+                        add_seed(topic, page_id);
+                        break;
+                    }
+                }
+            }
+        });
+    }
+
+    for(auto& topic : topics){
+        sort(topic.seeds.begin(), topic.seeds.end());
+        topic.seeds.erase(unique(topic.seeds.begin(), topic.seeds.end()), topic.seeds.end());
+        cout << "Topic " << topic.name << ": " << topic.seeds.size() << " seed pages" << endl;
+    }
+}
+
+// One Jacobi sweep over nodes [lo, hi) for S interleaved vectors. S is a
+// compile-time constant so the per-edge loop over the vectors is unrolled.
+template<int S>
+void personalized_sweep(int lo, int hi, const vector<double>& contrib, vector<double>& x,
+                        const vector<uint64_t>& seed_mask, const double* jump, double* diff){
+    double sum[S];
+    for(int i = lo; i < hi; i++){
+        fill(sum, sum + S, 0.0);
+        for(unsigned long long e = graph.in_offsets[i]; e < graph.in_offsets[i + 1]; e++){
+            const double* cj = &contrib[(size_t)graph.in_neighbours[e] * S];
+            for(int t=0; t<S; t++) sum[t] += cj[t];
+        }
+        double* xi = &x[(size_t)i * S];
+        uint64_t mask = seed_mask[i];
+        for(int t=0; t<S; t++){
+            double updated = damping_factor * sum[t] + (((mask >> t) & 1) ? jump[t] : 0.0);
+            diff[t] += std::abs(updated - xi[t]);
+            xi[t] = updated;
+        }
+    }
+}
+
+// Jacobi iteration of all topics at once. Scores are node-major, x[i*S + t],
+// with S the topic count rounded up to a power of two (the padding vectors
+// have no seeds and stay 0), so the in-link lists are streamed once and each
+// edge gathers the contributions of every topic from one place. Contributions
+// of the previous iterate are held separately, so x is updated in place.
+// Stops when the largest per-topic L1 change is below the tolerance.
+vector<double> run_personalized(const vector<Topic>& topics, int& stride){
+    decode_links();
+    const int N = graph.N;
+    const int T = topics.size();
+    int S = 1;
+    while(S < T) S *= 2;
+    stride = S;
+    cout << "Calculating " << T << " personalized pagerank vectors on " << num_threads << " threads..." << endl;
+
+    ThreadPool pool(num_threads);
+    const unsigned parts = num_threads;
+    const vector<int> bounds = partition_nodes(parts);
+
+    // Bit t of seed_mask[i] is set when node i is a seed of topic t.
+    vector<uint64_t> seed_mask(N, 0);
+    vector<double> x((size_t)N * S, 0.0);
+    for(int t=0; t<T; t++){
+        for(int i : topics[t].seeds){
+            seed_mask[i] |= uint64_t(1) << t;
+            x[(size_t)i * S + t] = 1.0 / topics[t].seeds.size();
+        }
+    }
+    vector<double> contrib((size_t)N * S, 0.0);
+    vector<double> partial_sink(parts * S), partial_diff(parts * S);
+    vector<double> jump(S, 0.0);
+
+    auto iteration_start_time = chrono::high_resolution_clock::now();
+    double residual = 0.0;
+    int iterations_done = 0;
+
+    for(int iteration = 0; iteration < num_iterations; iteration++){
+
+        pool.parallelFor(parts, [&](unsigned p){
+            double* sink = &partial_sink[p * S];
+            fill(sink, sink + S, 0.0);
+            for(int j = bounds[p]; j < bounds[p + 1]; j++){
+                int od = graph.out_degree[j];
+                const double* xj = &x[(size_t)j * S];
+                double* cj = &contrib[(size_t)j * S];
+                if(od > 0){
+                    for(int t=0; t<S; t++) cj[t] = xj[t] / od;
+                }
+                else{
+                    for(int t=0; t<S; t++){
+                        cj[t] = 0.0;
+                        sink[t] += xj[t];
+                    }
+                }
+            }
+        });
+
+        // Teleport and sink mass of topic t land on its seeds.
+        for(int t=0; t<T; t++){
+            double sink_mass = 0.0;
+            for(unsigned p=0; p<parts; p++) sink_mass += partial_sink[p * S + t];
+            jump[t] = (1.0 - damping_factor + damping_factor * sink_mass) / topics[t].seeds.size();
+        }
+
+        pool.parallelFor(parts, [&](unsigned p){
+            double* diff = &partial_diff[p * S];
+            fill(diff, diff + S, 0.0);
+            const int lo = bounds[p], hi = bounds[p + 1];
+            switch(S){
+                case 1: personalized_sweep<1>(lo, hi, contrib, x, seed_mask, jump.data(), diff); break;
+                case 2: personalized_sweep<2>(lo, hi, contrib, x, seed_mask, jump.data(), diff); break;
+                case 4: personalized_sweep<4>(lo, hi, contrib, x, seed_mask, jump.data(), diff); break;
+                case 8: personalized_sweep<8>(lo, hi, contrib, x, seed_mask, jump.data(), diff); break;
+                case 16: personalized_sweep<16>(lo, hi, contrib, x, seed_mask, jump.data(), diff); break;
+                case 32: personalized_sweep<32>(lo, hi, contrib, x, seed_mask, jump.data(), diff); break;
+                default: personalized_sweep<64>(lo, hi, contrib, x, seed_mask, jump.data(), diff); break;
+            }
+        });
+
+        residual = 0.0;
+        for(int t=0; t<T; t++){
+            double topic_diff = 0.0;
+            for(unsigned p=0; p<parts; p++) topic_diff += partial_diff[p * S + t];
+            residual = max(residual, topic_diff);
+        }
+        iterations_done = iteration + 1;
+        cout << "Iteration " << iterations_done << " done. Max L1 residual: " << residual << "\r" << flush;
+        if(residual < tolerance) break;
+    }
+
+    auto iteration_duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - iteration_start_time);
+    cout << "\nPersonalized vectors: " << T << ", iterations: " << iterations_done << ", max L1 residual: " << residual
+         << ", iteration time: " << iteration_duration.count() / 1000.0 << " sec." << endl;
+    return x;
+}
+
+bool save_topic_vectors(const string& path){
+    vector<Topic> topics;
+    if(!read_topics(path, topics)) return false;
+    resolve_topic_seeds(topics);
+    topics.erase(remove_if(topics.begin(), topics.end(), [](const Topic& topic){
+        if(topic.seeds.empty()) cerr << "Warning: topic " << topic.name << " has no seed pages in the graph, skipped." << endl;
+        return topic.seeds.empty();
+    }), topics.end());
+    if(topics.empty()) return false;
+
+    int stride;
+    vector<double> x = run_personalized(topics, stride);
+
+    const int N = graph.N;
+    const int T = topics.size();
+    ScoreFileWriter writer(graph.dense_to_real, N);
+    vector<double> column(N);
+    for(int t=0; t<T; t++){
+        for(int i=0; i<N; i++) column[i] = x[(size_t)i * stride + t];
+        writer.addLogColumn(topics[t].name, column);
+    }
+    if(!writer.write(TOPICS_OUTPUT_FILE)){
+        cerr << "Error: could not write " << TOPICS_OUTPUT_FILE << endl;
+        return false;
+    }
+    cout << "Saved " << T << " topic vectors to " << TOPICS_OUTPUT_FILE << endl;
+    return true;
+}
+
+// Link signals (--signals): in-degree, HITS hub and authority, and CheiRank
+// (PageRank of the reversed graph, high for pages that link out widely),
+// written to SIGNALS_OUTPUT_FILE for use as ranking priors.
+//
+// One iteration is two sweeps. The in-link sweep updates the authorities from
+// the hubs. The out-link sweep, over the transposed graph, updates the hubs
+// from the new authorities and CheiRank from its previous iterate together:
+// both read one interleaved record per link target. HITS vectors are scaled
+// to sum to 1 every iteration; everything stops when the largest of the three
+// L1 changes is below the tolerance.
+
+const string SIGNALS_OUTPUT_FILE = "link_signals.bin";
+
+struct LinkSignals{
+    vector<double> in_degree;
+    vector<double> hub;
+    vector<double> authority;
+    vector<double> cheirank;
+};
+
+// Scales x to sum to 1 and returns its L1 change against previous, which is
+// normalised the same way.
+double normalize_and_diff(ThreadPool& pool, const vector<int>& bounds, vector<double>& x, const vector<double>& previous){
+    const unsigned parts = bounds.size() - 1;
+    vector<double> partial(parts);
+    pool.parallelFor(parts, [&](unsigned p){
+        double sum = 0.0;
+        for(int i = bounds[p]; i < bounds[p + 1]; i++) sum += x[i];
+        partial[p] = sum;
+    });
+    double total = reduce_parts(partial);
+    double scale = total > 0 ? 1.0 / total : 0.0;
+    pool.parallelFor(parts, [&](unsigned p){
+        double diff = 0.0;
+        for(int i = bounds[p]; i < bounds[p + 1]; i++){
+            x[i] *= scale;
+            diff += std::abs(x[i] - previous[i]);
+        }
+        partial[p] = diff;
+    });
+    return reduce_parts(partial);
+}
+
+LinkSignals compute_link_signals(){
+    decode_links();
+    const int N = graph.N;
+    cout << "Calculating link signals (in-degree, HITS, CheiRank) on " << num_threads << " threads..." << endl;
+    auto start_time = chrono::high_resolution_clock::now();
+
+    OutLinks out = transpose_graph();
+    ThreadPool pool(num_threads);
+    const unsigned parts = num_threads;
+    const vector<int> in_bounds = partition_nodes(parts);
+    const vector<int> out_bounds = partition_nodes(parts, out.offsets.data());
+
+    LinkSignals signals;
+    signals.in_degree.resize(N);
+    for(int v=0; v<N; v++) signals.in_degree[v] = graph.in_offsets[v + 1] - graph.in_offsets[v];
+
+    vector<double> hub(N, 1.0 / N), authority(N, 1.0 / N), cheirank(N, 1.0 / N);
+    vector<double> new_hub(N), new_authority(N), new_cheirank(N);
+    // Per link target v: { authority[v], cheirank[v] / in_degree(v) }.
+    vector<array<double, 2>> target(N);
+    vector<double> partial_sink(parts), partial_diff(parts);
+
+    double residual = 0.0;
+    int iterations_done = 0;
+    for(int iteration = 0; iteration < num_iterations; iteration++){
+
+        pool.parallelFor(parts, [&](unsigned p){
+            for(int v = in_bounds[p]; v < in_bounds[p + 1]; v++){
+                double sum = 0.0;
+                for(unsigned long long e = graph.in_offsets[v]; e < graph.in_offsets[v + 1]; e++){
+                    sum += hub[graph.in_neighbours[e]];
+                }
+                new_authority[v] = sum;
+            }
+        });
+        double authority_diff = normalize_and_diff(pool, in_bounds, new_authority, authority);
+        authority.swap(new_authority);
+
+        // Pages without in-links are the sinks of the reversed graph.
+        pool.parallelFor(parts, [&](unsigned p){
+            double sink = 0.0;
+            for(int v = in_bounds[p]; v < in_bounds[p + 1]; v++){
+                double degree = signals.in_degree[v];
+                target[v] = {authority[v], degree > 0 ? cheirank[v] / degree : 0.0};
+                if(degree == 0) sink += cheirank[v];
+            }
+            partial_sink[p] = sink;
+        });
+        const double base = (1.0 - damping_factor + damping_factor * reduce_parts(partial_sink)) / N;
+
+        pool.parallelFor(parts, [&](unsigned p){
+            double diff = 0.0;
+            for(int u = out_bounds[p]; u < out_bounds[p + 1]; u++){
+                double hub_sum = 0.0, rank_sum = 0.0;
+                for(unsigned long long e = out.offsets[u]; e < out.offsets[u + 1]; e++){
+                    const array<double, 2>& t = target[out.neighbours[e]];
+                    hub_sum += t[0];
+                    rank_sum += t[1];
+                }
+                new_hub[u] = hub_sum;
+                new_cheirank[u] = base + damping_factor * rank_sum;
+                diff += std::abs(new_cheirank[u] - cheirank[u]);
+            }
+            partial_diff[p] = diff;
+        });
+        double cheirank_diff = reduce_parts(partial_diff);
+        cheirank.swap(new_cheirank);
+        double hub_diff = normalize_and_diff(pool, out_bounds, new_hub, hub);
+        hub.swap(new_hub);
+
+        residual = max({authority_diff, hub_diff, cheirank_diff});
+        iterations_done = iteration + 1;
+        cout << "Iteration " << iterations_done << " done. Max L1 residual: " << residual << "\r" << flush;
+        if(residual < tolerance) break;
+    }
+
+    auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - start_time);
+    cout << "\nLink signals: iterations: " << iterations_done << ", max L1 residual: " << residual
+         << ", time: " << duration.count() / 1000.0 << " sec." << endl;
+
+    signals.hub = move(hub);
+    signals.authority = move(authority);
+    signals.cheirank = move(cheirank);
+    return signals;
+}
+
+bool save_link_signals(){
+    LinkSignals signals = compute_link_signals();
+
+    ScoreFileWriter writer(graph.dense_to_real, graph.N);
+    writer.addFloatColumn("indegree", signals.in_degree);
+    writer.addLogColumn("hub", signals.hub);
+    writer.addLogColumn("authority", signals.authority);
+    writer.addLogColumn("cheirank", signals.cheirank);
+    if(!writer.write(SIGNALS_OUTPUT_FILE)){
+        cerr << "Error: could not write " << SIGNALS_OUTPUT_FILE << endl;
+        return false;
+    }
+    cout << "Saved link signals to " << SIGNALS_OUTPUT_FILE << endl;
+    return true;
+}
+
 void save_results(const vector<double>& scores, int N){
     cout << "Saving results..." << endl;
     ofstream outfile(OUTPUT_FILE);
@@ -251,10 +1761,11 @@ void save_results(const vector<double>& scores, int N){
         exit(1);
     }
 
-    outfile << scientific;
+    // Enough digits for --incremental to warm-start from this file.
+    outfile << scientific << setprecision(12);
 
     for(int i=0; i<N; i++){
-        outfile << dense_to_real[i] << "," << scores[i] << "\n";
+        outfile << graph.dense_to_real[i] << "," << scores[i] << "\n";
 
         if(i % 10000 == 0){
             cout << i << " scores saved\r" << flush;
@@ -264,23 +1775,170 @@ void save_results(const vector<double>& scores, int N){
     outfile.close();
     cout << "Done! Saved to " << OUTPUT_FILE << endl;
 
+    // Memory-mapped by search and autocomplete.
+    ScoreFileWriter writer(graph.dense_to_real, N);
+    writer.addFloatColumn(PAGERANK_COLUMN, scores);
+    if(!writer.write(BINARY_OUTPUT_FILE)){
+        cerr << "Could not write " << BINARY_OUTPUT_FILE << endl;
+        exit(1);
+    }
+    cout << "Saved to " << BINARY_OUTPUT_FILE << endl;
+
 }
 
 
-int main(){
+int main(int argc, char* argv[]){
+
+    bool rebuild = false;
+    string delta_path;
+    string previous_path = OUTPUT_FILE;
+    string topics_path;
+    bool signals = false;
+    for(int i=1; i<argc; i++){
+        string arg = argv[i];
+        if(arg == "--rebuild"){
+            rebuild = true;
+        }
+        else if(arg == "--iterations" && i + 1 < argc){
+            num_iterations = stoi(argv[++i]);
+        }
+        else if(arg == "--damping" && i + 1 < argc){
+            damping_factor = stod(argv[++i]);
+        }
+        else if(arg == "--tolerance" && i + 1 < argc){
+            tolerance = stod(argv[++i]);
+        }
+        else if(arg == "--solver" && i + 1 < argc && find(begin(SOLVERS), end(SOLVERS), argv[i + 1]) != end(SOLVERS)){
+            solver = argv[++i];
+        }
+        else if(arg == "--threads" && i + 1 < argc){
+            num_threads = max(1, stoi(argv[++i]));
+        }
+        else if(arg == "--incremental" && i + 1 < argc){
+            delta_path = argv[++i];
+        }
+        else if(arg == "--previous" && i + 1 < argc){
+            previous_path = argv[++i];
+        }
+        else if(arg == "--topics" && i + 1 < argc){
+            topics_path = argv[++i];
+        }
+        else if(arg == "--signals"){
+            signals = true;
+        }
+        else if(arg == "--order" && i + 1 < argc && find(begin(NODE_ORDERS), end(NODE_ORDERS), argv[i + 1]) != end(NODE_ORDERS)){
+            node_order = argv[++i];
+        }
+        else if(arg == "--encoding" && i + 1 < argc && find(begin(LINK_ENCODINGS), end(LINK_ENCODINGS), argv[i + 1]) != end(LINK_ENCODINGS)){
+            link_encoding = argv[++i];
+        }
+        else{
+            cerr << "Usage: ./pageRank [--solver jacobi|gauss-seidel|aitken|quadratic] [--tolerance L1] [--iterations MAX] [--damping D] [--threads T] [--order none|degree|rcm] [--encoding raw|gaps] [--topics FILE] [--signals] [--rebuild]" << endl;
+            cerr << "       ./pageRank --incremental delta.csv [--previous scores.csv] [solver options]" << endl;
+            return 1;
+        }
+    }
 
     cout << "----- Pagerank Starting -----" << endl;
+    auto load_start_time = chrono::high_resolution_clock::now();
 
-    find_valid_pageids();
+    if(!delta_path.empty()){
+        if(!load_graph_cache(false)){
+            cerr << "Error: --incremental needs the graph cache of the previous run (" << GRAPH_CACHE_FILE << ")" << endl;
+            return 1;
+        }
+        cout << "Previous graph mapped: " << graph.N << " nodes, " << graph.E << " edges." << endl;
+        const uint32_t encoding = graph.encoding;
 
-    int N = map_ids_pass_one();
+        vector<double> final_scores = run_incremental(delta_path, previous_path);
+        if(encoding == 1) encode_links();
 
-    build_graph_pass_two(N);
+        // The updated graph replaces the cache, so the next delta applies on top of it.
+        if(save_graph_cache() && load_graph_cache(false)){
+            release_build_arrays();
+            cout << "Graph cache saved to " << GRAPH_CACHE_FILE << endl;
+        }
+        else{
+            cerr << "Warning: could not write " << GRAPH_CACHE_FILE << ", the next --incremental run will not see this delta." << endl;
+        }
+        save_results(final_scores, graph.N);
+        if(!topics_path.empty() && !save_topic_vectors(topics_path)) return 1;
+        if(signals && !save_link_signals()) return 1;
+        return 0;
+    }
 
-    vector<double> final_scores = run_pagerank(N);
+    bool cache_current = !rebuild && load_graph_cache();
+    if(cache_current){
+        cout << "Graph cache mapped: " << graph.N << " nodes, " << graph.E << " edges, " << NODE_ORDERS[graph.ordering] << " order, "
+             << LINK_ENCODINGS[graph.encoding] << " links." << endl;
+    }
+    else{
+        find_valid_pageids();
+
+        MappedFile csv;
+        if(!csv.open(PAGELINKS_FILE)){
+            cerr << "Error: Pagelinks not opening" << endl;
+            return 1;
+        }
+        csv.willNeed();
 
-    save_results(final_scores, N);
+        int N = map_ids_pass_one(csv);
 
+        build_graph_pass_two(csv, N);
+    }
+
+    uint32_t ordering = graph.ordering;
+    if(!node_order.empty()){
+        ordering = find(begin(NODE_ORDERS), end(NODE_ORDERS), node_order) - begin(NODE_ORDERS);
+    }
+    uint32_t encoding = graph.encoding;
+    if(!link_encoding.empty()){
+        encoding = find(begin(LINK_ENCODINGS), end(LINK_ENCODINGS), link_encoding) - begin(LINK_ENCODINGS);
+    }
+    if(ordering != graph.ordering){
+        auto reorder_start_time = chrono::high_resolution_clock::now();
+        if(ordering != 0) decode_links();
+        vector<int> order;
+        if(ordering == 1) order = degree_order();
+        else if(ordering == 2) order = rcm_order();
+        else{
+            // Back to first-appearance order is not recoverable from the cache.
+            cerr << "Warning: the cache is in " << NODE_ORDERS[graph.ordering] << " order, use --rebuild for the original numbering." << endl;
+        }
+        if(!order.empty()){
+            apply_order(order, ordering);
+            cache_current = false;
+            auto reorder_duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - reorder_start_time);
+            cout << "Reordered graph (" << NODE_ORDERS[ordering] << "): " << reorder_duration.count() / 1000.0 << " sec." << endl;
+        }
+    }
+    if(encoding != graph.encoding){
+        detach_node_arrays();
+        if(encoding == 1) encode_links();
+        else decode_links();
+        cache_current = false;
+    }
+
+    if(!cache_current){
+        // Run from the mapping as well, so the heap copy of the graph is released.
+        if(save_graph_cache() && load_graph_cache()){
+            release_build_arrays();
+            cout << "Graph cache saved to " << GRAPH_CACHE_FILE << endl;
+        }
+        else{
+            cerr << "Warning: could not write " << GRAPH_CACHE_FILE << ", continuing from memory." << endl;
+        }
+    }
+
+    auto load_duration = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - load_start_time);
+    cout << "Graph load time: " << load_duration.count() / 1000.0 << " sec." << endl;
+
+    vector<double> final_scores = run_pagerank();
+
+    save_results(final_scores, graph.N);
+
+    if(!topics_path.empty() && !save_topic_vectors(topics_path)) return 1;
+    if(signals && !save_link_signals()) return 1;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,35 @@
+#ifndef PEAK_RSS_HPP
+#define PEAK_RSS_HPP
+
+#include <cstddef>
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN     // keeps out winsock.h, which clashes with winsock2.h
+    #endif
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+// Peak resident set size of the current process in bytes, 0 if unavailable.
+inline size_t peak_rss_bytes() {
+    #ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return counters.PeakWorkingSetSize;
+        }
+        return 0;
+    #else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        #ifdef __APPLE__
+            return usage.ru_maxrss;
+        #else
+            return static_cast<size_t>(usage.ru_maxrss) * 1024;
+        #endif
+    #endif
+}
+
+#endif // PEAK_RSS_HPP
@@ -0,0 +1,312 @@
+#ifndef SCORE_FILE_HPP
+#define SCORE_FILE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "index_format.hpp"
+#include "mmap_file.hpp"
+
+using namespace std;
+
+// Column store of per-page scores, written by pageRank and memory-mapped by
+// the query side. All columns share one row per page, ordered by page id.
+//
+//   ScoreFileHeader
+//   int32  page_ids[numPages]            ascending page ids
+//   uint32 id_buckets[numBuckets + 1]    rows whose id >> bucketShift == b are
+//                                        id_buckets[b] .. id_buckets[b+1]
+//   ScoreColumn columns[numColumns]
+//   column data
+//
+// Every section starts on a 64-byte boundary. A lookup by page id is one
+// bucket read plus a binary search over a handful of ids. The checksum is
+// FNV-1a over the header bytes before the checksum field.
+//
+// Column types:
+//   SCORE_FLOAT32   float per row
+//   SCORE_LOG_U16   uint16 per row; 0 is a score of 0, any other code c is
+//                   exp(logMin + (c - 1) * logStep). The relative error is
+//                   logStep / 2, about 2e-4 for scores spanning 1e-12 .. 1.
+
+const char SCORE_MAGIC[8] = {'W', 'K', 'S', 'C', 'O', 'R', 'E', '\0'};
+const uint32_t SCORE_VERSION = 1;
+const uint32_t SCORE_FLOAT32 = 0;
+const uint32_t SCORE_LOG_U16 = 1;
+const size_t SCORE_NAME_SIZE = 32;
+
+struct ScoreFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t numPages;
+    uint32_t numColumns;
+    uint32_t bucketShift;
+    uint64_t numBuckets;
+    uint64_t idsPos;
+    uint64_t bucketsPos;
+    uint64_t columnsPos;
+    uint64_t checksum;
+};
+
+struct ScoreColumn {
+    char name[SCORE_NAME_SIZE];
+    uint32_t type;
+    uint32_t reserved;
+    double logMin;
+    double logStep;
+    uint64_t dataPos;
+};
+
+inline uint64_t score_align(uint64_t pos) {
+    return (pos + 63) & ~uint64_t(63);
+}
+
+// Collects columns in memory and writes the file in one go. Values are given
+// per node in the caller's order; pageIds[i] is the page id of node i.
+class ScoreFileWriter {
+public:
+    ScoreFileWriter(const int* pageIds, size_t numPages) : rows(numPages) {
+        iota(rows.begin(), rows.end(), 0);
+        sort(rows.begin(), rows.end(), [pageIds](size_t a, size_t b) { return pageIds[a] < pageIds[b]; });
+        ids.resize(numPages);
+        for (size_t r = 0; r < numPages; r++) ids[r] = pageIds[rows[r]];
+    }
+
+    void addFloatColumn(const string& name, const vector<double>& values) {
+        ScoreColumn column = makeColumn(name, SCORE_FLOAT32);
+        string bytes(ids.size() * sizeof(float), '\0');
+        float* out = reinterpret_cast<float*>(bytes.data());
+        for (size_t r = 0; r < rows.size(); r++) out[r] = static_cast<float>(values[rows[r]]);
+        columns.push_back(column);
+        data.push_back(move(bytes));
+    }
+
+    // Log-scale quantisation over the range of the positive values.
+    void addLogColumn(const string& name, const vector<double>& values) {
+        ScoreColumn column = makeColumn(name, SCORE_LOG_U16);
+        double lo = HUGE_VAL, hi = -HUGE_VAL;
+        for (double v : values) {
+            if (v > 0) {
+                lo = min(lo, log(v));
+                hi = max(hi, log(v));
+            }
+        }
+        if (lo > hi) lo = hi = 0.0;
+        column.logMin = lo;
+        column.logStep = (hi > lo) ? (hi - lo) / 65534.0 : 1.0;
+
+        string bytes(ids.size() * sizeof(uint16_t), '\0');
+        uint16_t* out = reinterpret_cast<uint16_t*>(bytes.data());
+        for (size_t r = 0; r < rows.size(); r++) {
+            double v = values[rows[r]];
+            if (v <= 0) continue;
+            double code = 1.0 + round((log(v) - column.logMin) / column.logStep);
+            out[r] = static_cast<uint16_t>(clamp(code, 1.0, 65535.0));
+        }
+        columns.push_back(column);
+        data.push_back(move(bytes));
+    }
+
+    bool write(const string& path) const {
+        ScoreFileHeader header = {};
+        memcpy(header.magic, SCORE_MAGIC, sizeof(SCORE_MAGIC));
+        header.version = SCORE_VERSION;
+        header.headerSize = sizeof(ScoreFileHeader);
+        header.numPages = ids.size();
+        header.numColumns = columns.size();
+
+        // About four pages per bucket.
+        int64_t maxId = ids.empty() ? 0 : ids.back();
+        uint64_t wanted = max<uint64_t>(1, ids.size() / 4);
+        while (static_cast<uint64_t>(maxId >> header.bucketShift) + 1 > wanted) header.bucketShift++;
+        header.numBuckets = static_cast<uint64_t>(maxId >> header.bucketShift) + 1;
+
+        vector<uint32_t> buckets(header.numBuckets + 1, 0);
+        for (int id : ids) buckets[(id >> header.bucketShift) + 1]++;
+        for (uint64_t b = 0; b < header.numBuckets; b++) buckets[b + 1] += buckets[b];
+
+        header.idsPos = score_align(sizeof(ScoreFileHeader));
+        header.bucketsPos = score_align(header.idsPos + ids.size() * sizeof(int32_t));
+        header.columnsPos = score_align(header.bucketsPos + buckets.size() * sizeof(uint32_t));
+        uint64_t pos = score_align(header.columnsPos + columns.size() * sizeof(ScoreColumn));
+        vector<ScoreColumn> table = columns;
+        for (size_t c = 0; c < table.size(); c++) {
+            table[c].dataPos = pos;
+            pos = score_align(pos + data[c].size());
+        }
+        header.checksum = fnv1a(&header, offsetof(ScoreFileHeader, checksum));
+
+        ofstream out(path, ios::binary);
+        if (!out.is_open()) return false;
+        auto writeAt = [&out](uint64_t at, const void* bytes, uint64_t len) {
+            static const char zeros[64] = {};
+            out.write(zeros, at - static_cast<uint64_t>(out.tellp()));
+            out.write(static_cast<const char*>(bytes), len);
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeAt(header.idsPos, ids.data(), ids.size() * sizeof(int32_t));
+        writeAt(header.bucketsPos, buckets.data(), buckets.size() * sizeof(uint32_t));
+        writeAt(header.columnsPos, table.data(), table.size() * sizeof(ScoreColumn));
+        for (size_t c = 0; c < table.size(); c++) writeAt(table[c].dataPos, data[c].data(), data[c].size());
+        out.close();
+        return !out.fail();
+    }
+
+private:
+    vector<size_t> rows;
+    vector<int32_t> ids;
+    vector<ScoreColumn> columns;
+    vector<string> data;
+
+    static ScoreColumn makeColumn(const string& name, uint32_t type) {
+        ScoreColumn column = {};
+        memcpy(column.name, name.data(), min(name.size(), SCORE_NAME_SIZE - 1));
+        column.type = type;
+        return column;
+    }
+};
+
+// Read-only view of a mapped score file. Switching columns costs nothing;
+// every column is paged in on first use and shared with other processes.
+class ScoreFile {
+public:
+    bool open(const string& path, string& error) {
+        if (!file.open(path)) {
+            error = "could not map " + path;
+            return false;
+        }
+        if (file.size() < sizeof(ScoreFileHeader)) {
+            error = "file too short for header";
+            return fail();
+        }
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, SCORE_MAGIC, sizeof(SCORE_MAGIC)) != 0) {
+            error = "bad magic, not a score file";
+            return fail();
+        }
+        if (header.version != SCORE_VERSION || header.headerSize != sizeof(ScoreFileHeader)) {
+            error = "unsupported score file version " + to_string(header.version);
+            return fail();
+        }
+        if (header.checksum != fnv1a(&header, offsetof(ScoreFileHeader, checksum))) {
+            error = "header checksum mismatch";
+            return fail();
+        }
+        if (header.columnsPos + header.numColumns * sizeof(ScoreColumn) > file.size()) {
+            error = "column table past end of file";
+            return fail();
+        }
+        if (header.idsPos + header.numPages * sizeof(int32_t) > file.size()
+            || header.bucketsPos + (header.numBuckets + 1) * sizeof(uint32_t) > file.size()) {
+            error = "file truncated";
+            return fail();
+        }
+
+        ids = reinterpret_cast<const int32_t*>(file.data() + header.idsPos);
+        buckets = reinterpret_cast<const uint32_t*>(file.data() + header.bucketsPos);
+        columns = reinterpret_cast<const ScoreColumn*>(file.data() + header.columnsPos);
+        if (buckets[header.numBuckets] != header.numPages) {
+            error = "page buckets do not cover the page ids";
+            return fail();
+        }
+        for (uint32_t c = 0; c < header.numColumns; c++) {
+            size_t width = (columns[c].type == SCORE_FLOAT32) ? sizeof(float) : sizeof(uint16_t);
+            if (columns[c].dataPos + header.numPages * width > file.size()) {
+                error = "column " + to_string(c) + " past end of file";
+                return fail();
+            }
+        }
+        return true;
+    }
+
+    uint64_t size() const { return header.numPages; }
+    int numColumns() const { return header.numColumns; }
+
+    string_view columnName(int column) const {
+        const char* name = columns[column].name;
+        return string_view(name, strnlen(name, SCORE_NAME_SIZE));
+    }
+
+    // Column index by name, -1 if there is none.
+    int findColumn(string_view name) const {
+        for (int c = 0; c < numColumns(); c++) {
+            if (columnName(c) == name) return c;
+        }
+        return -1;
+    }
+
+    // Row of a page id, -1 if the page has no scores.
+    int64_t row(int pageId) const {
+        if (pageId < 0) return -1;
+        uint64_t bucket = static_cast<uint64_t>(pageId) >> header.bucketShift;
+        if (bucket >= header.numBuckets) return -1;
+        const int32_t* first = ids + buckets[bucket];
+        const int32_t* last = ids + buckets[bucket + 1];
+        const int32_t* it = lower_bound(first, last, pageId);
+        return (it != last && *it == pageId) ? it - ids : -1;
+    }
+
+    double value(int column, int64_t row) const {
+        const ScoreColumn& col = columns[column];
+        const char* data = file.data() + col.dataPos;
+        if (col.type == SCORE_FLOAT32) return reinterpret_cast<const float*>(data)[row];
+        uint16_t code = reinterpret_cast<const uint16_t*>(data)[row];
+        return code == 0 ? 0.0 : exp(col.logMin + (code - 1) * col.logStep);
+    }
+
+    // Score of a page in a column, 0 for pages not in the file.
+    double score(int column, int pageId) const {
+        int64_t r = row(pageId);
+        return r < 0 ? 0.0 : value(column, r);
+    }
+
+private:
+    MappedFile file;
+    ScoreFileHeader header = {};
+    const int32_t* ids = nullptr;
+    const uint32_t* buckets = nullptr;
+    const ScoreColumn* columns = nullptr;
+
+    bool fail() {
+        file.close();
+        return false;
+    }
+};
+
+// The global PageRank, pagerank_scores.bin: one SCORE_FLOAT32 column named
+// PAGERANK_COLUMN. Shared by search and autocomplete in place of parsing
+// pagerank_scores.csv into a hash map.
+const char PAGERANK_COLUMN[] = "pagerank";
+
+class PageRankScores {
+public:
+    bool open(const string& path, string& error) {
+        if (!file.open(path, error)) return false;
+        column = file.findColumn(PAGERANK_COLUMN);
+        if (column < 0) {
+            error = "no " + string(PAGERANK_COLUMN) + " column";
+            return false;
+        }
+        return true;
+    }
+
+    // Number of ranked pages.
+    uint64_t size() const { return file.size(); }
+
+    // 0 for pages outside the link graph.
+    double score(int pageId) const { return file.score(column, pageId); }
+
+private:
+    ScoreFile file;
+    int column = -1;
+};
+
+#endif // SCORE_FILE_HPP
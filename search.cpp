@@ -9,24 +9,33 @@
 #include <iomanip>
 #include <chrono>
 #include <unordered_set>
-#include "json.hpp"
 #include "check_stem.hpp"
-
-using json = nlohmann::json;
+#include "index_format.hpp"
+#include "score_file.hpp"
+#include "title_store.hpp"
 
 const string INDEX_FILE = "BinsAndTxtx\\index.bin";
-const string OFFSET_FILE = "BinsAndTxtx\\offset.txt";
-const string DOC_INFO_FILE=  "data_files\\doc_info.jsonl";
+const string DICTIONARY_FILE = "BinsAndTxtx\\dictionary.bin";
+const string TITLE_STORE_FILE = "titles.bin";
 const string PYTHON_STEMMER_SCRIPT = "stemmer_bridge.py";
 const string STOPWORD_FILE = "stopwords.txt";
-const string PAGERANK_SCORES_PATH = "pagerank_scores.csv";
+const string PAGERANK_SCORES_PATH = "pagerank_scores.bin";
+const string TOPIC_SCORES_PATH = "pagerank_topics.bin";
 const float alpha = 0.2;
 
-unordered_map<int, pair<string, int>> doc_details;
+// Titles and document lengths, written by ./autoCompleteTrie build and mapped
+// rather than parsed from doc_info.jsonl.
+TitleStore doc_titles;
 double avg_doc_length = 0.0;
+IndexHeader index_header;
 
 unordered_set<string> stopwords;
-unordered_map<int, double> pagerank_scores;
+PageRankScores pagerank_scores;
+// Personalised PageRank vectors from pageRank --topics, one column per topic.
+// A query starting with @name ranks with that column instead of the global
+// scores; the file stays mapped, so switching is free.
+ScoreFile topic_scores;
+bool topics_loaded = false;
 
 struct Posting{
     int doc_id;
@@ -41,60 +50,18 @@ struct SearchResult{
 
 
 void load_titles(){
-    cout << "Loading documents into hashmap..." << endl;
-    ifstream infile(DOC_INFO_FILE);
-    if(!infile.is_open()){
-        cerr << "Error: Could not open doc file";
-        return;
-    }
-
-    doc_details.reserve(7084107);
-
-    string line;
-    long long count = 0;
-
-    auto start_time = chrono::high_resolution_clock::now();
-    auto batch_start_time = start_time; 
-    long long total_corpus_length = 0;
-
-    while(getline(infile, line)){
-        try{
-            auto j = json::parse(line);
-            int doc_id = j["id"];
-            string doc_title = j["title"];
-            int doc_length = j["len"];
-
-            doc_details[doc_id] = {doc_title, doc_length};
-            total_corpus_length += doc_length;
-
-            count++;
-            if(count % 100000 == 0){
-                auto batch_end_time = chrono::high_resolution_clock::now();
-                auto batch_duration = chrono::duration_cast<chrono::milliseconds>(batch_end_time - batch_start_time);
-                auto total_duration = chrono::duration_cast<chrono::seconds>(batch_end_time - start_time).count();
-                int minutes = total_duration / 60;
-                int seconds=  total_duration % 60;
-                cout << count << " documents processed. Batch Time: " << batch_duration.count() / 1000.0 << " sec. Total Time: " << minutes << " min, " << seconds << " sec.\r";
-                batch_start_time = batch_end_time;
-            }
-        }
-        catch(exception &e){
-            cerr << "Error: " << e.what() << endl;
-            return;
-        }
-    }
-    cout << endl;
-    infile.close();
-    if(doc_details.size() > 0){
-        avg_doc_length = (double)total_corpus_length / count; 
+    cout << "Loading titles..." << endl;
+    string error;
+    if(!doc_titles.open(TITLE_STORE_FILE, error)){
+        cerr << "Error: Title store could not be opened: " << error << " (run ./autoCompleteTrie build first)" << endl;
+        exit(1);
     }
-    cout << "Titles loaded. Total unique docs: " << doc_details.size() << endl;
-    return;
+    cout << "Titles mapped: " << doc_titles.size() << " docs." << endl;
 }
 
 string get_title(int doc_id){
-    auto it = doc_details.find(doc_id);
-    if(it != doc_details.end()) return it->second.first;
+    string title;
+    if(doc_titles.titleOf(doc_id, title)) return title;
     return "Unknown Title";
 }
 
@@ -116,80 +83,71 @@ void load_stopwords(){
 
 void load_pagerank_scores(){
     cout << "Loading pagerank scores..." << endl;
-    ifstream infile(PAGERANK_SCORES_PATH);
-    if(!infile.is_open()){
-        cerr << "Error: Pagerank file could not be opened";
+    string error;
+    if(!pagerank_scores.open(PAGERANK_SCORES_PATH, error)){
+        cerr << "Error: Pagerank file could not be opened: " << error << endl;
         exit(1);
     }
+    cout << "Pagerank scores mapped: " << pagerank_scores.size() << " pages." << endl;
+}
 
 
-    pagerank_scores.reserve(7084107);
-    string line;
-    long long count = 0;
-
-    while(getline(infile, line)){
-        size_t comma_pos = line.find(',');
-        if(comma_pos == string::npos) continue;
-        try{
-            int doc_id = stoi(line.substr(0, comma_pos));
-            double score = stod(line.substr(comma_pos+1));
-
-            pagerank_scores[doc_id] = score;
-            count++;
-
-            if(count % 10000 == 0){
-                cout << count << " pages processed for pagerank.\r" << flush;
-            }
-
-        }
-        catch(exception &e){
-            cout << "Error: " << e.what() << endl;
-            continue;
-        }
+void load_topic_vectors(){
+    string error;
+    topics_loaded = topic_scores.open(TOPIC_SCORES_PATH, error);
+    if(!topics_loaded){
+        cout << "No topic vectors (" << error << "), @topic queries use the global pagerank." << endl;
+        return;
     }
-
-    cout << "\nPagerank scores loaded..." << endl;
-    return;
-
+    cout << "Topic vectors:";
+    for(int c=0; c<topic_scores.numColumns(); c++) cout << " @" << topic_scores.columnName(c);
+    cout << endl;
 }
 
+// Splits a leading "@name " off the query and returns the topic column, or -1
+// for the global pagerank.
+int take_topic(string& query){
+    if(query.empty() || query[0] != '@') return -1;
+    size_t space = query.find(' ');
+    string name = query.substr(1, space == string::npos ? string::npos : space - 1);
+    query = (space == string::npos) ? "" : query.substr(space + 1);
+
+    int column = topics_loaded ? topic_scores.findColumn(name) : -1;
+    if(column < 0) cout << "Unknown topic @" << name << ", using the global pagerank." << endl;
+    return column;
+}
 
 int main(){
 
     cout << "----- Wikipedia Search Engine -----" << endl;
     cout << "Loading Dictionary..." << endl;
 
-    load_titles();
-    load_stopwords();   
-    load_pagerank_scores(); 
-
-    unordered_map<string, long long> offsets;
-    ifstream offset_file(OFFSET_FILE);
-
-    if(!offset_file.is_open()){
-        cerr << "Erorr: Output file could not open";
+    ifstream bin_file(INDEX_FILE, ios::binary);
+    
+    if(!bin_file.is_open()){
+        cerr << "Error: Could not open bin file";
         return 1;
     }
 
-    string term;
-    long long pos;
-
-    while(offset_file >> term >> pos){
-        offsets[term] = pos;
+    string header_error;
+    if(!read_index_header(bin_file, index_header, header_error)){
+        cerr << "Error: Invalid index header: " << header_error << endl;
+        return 1;
     }
+    avg_doc_length = index_header.avgDocLength;
+    const double total_docs = static_cast<double>(index_header.numDocs);
+    cout << "Total Documents: " << index_header.numDocs << ", Terms: " << index_header.numTerms << ", Avg Doc Length: " << avg_doc_length << endl;
 
-    offset_file.close();
+    load_titles();
+    load_stopwords();   
+    load_pagerank_scores(); 
+    load_topic_vectors();
 
-    ifstream bin_file(INDEX_FILE, ios::binary);
-    
-    if(!bin_file.is_open()){
-        cerr << "Error: Could not open bin file";
+    Dictionary dictionary;
+    if(!dictionary.load(DICTIONARY_FILE)){
+        cerr << "Error: Dictionary file could not be loaded";
         return 1;
     }
-
-    int total_docs;
-    bin_file.read(reinterpret_cast<char*>(&total_docs), sizeof(total_docs));
-    cout << "Total Documents: " << total_docs << endl;
     
     PythonStemmer pstemmer(PYTHON_STEMMER_SCRIPT);
 
@@ -204,6 +162,7 @@ int main(){
         cout << "\nSearch > ";
         if(!getline(cin, input_line) || input_line == "exit") break;
 
+        int topic = take_topic(input_line);
         if(input_line.empty()) continue;
 
         auto start_time = chrono::high_resolution_clock::now();
@@ -224,12 +183,12 @@ int main(){
         unordered_map<int, double> doc_scores;
 
         for(const string& term : search_term){
-            if(offsets.find(term) == offsets.end()){
+            long long byte_offset;
+            if(!dictionary.find(term, byte_offset)){
                 cout << "Term not found in index" << endl;
                 continue;
             } 
 
-            long long byte_offset = offsets[term];
             cout << "Byte offset: " << byte_offset;
             if(bin_file.fail() || bin_file.bad()) {
                 cerr << "  WARNING: Stream in bad state before seek!" << endl;
@@ -257,7 +216,7 @@ int main(){
 
             cout << "  doc_freq: " << doc_freq << endl;
 
-            if(doc_freq <= 0 || doc_freq > 7084107) {
+            if(doc_freq <= 0 || (uint64_t)doc_freq > index_header.numDocs) {
                 cerr << "  ERROR: Invalid doc_freq value!" << endl;
                 continue;
             }
@@ -276,9 +235,9 @@ int main(){
 
             for(const auto& p : postings){
                 int doc_len = int(avg_doc_length);
-                auto it = doc_details.find(p.doc_id);
-                if(it != doc_details.end()){
-                    doc_len = it->second.second;
+                int64_t stored_len = doc_titles.lengthOf(p.doc_id);
+                if(stored_len >= 0){
+                    doc_len = int(stored_len);
                 }
 
                 float raw_freq = p.tf_score * doc_len;
@@ -287,7 +246,7 @@ int main(){
                 double denominator = raw_freq + k1 * (1 - b + b * ((double) doc_len / avg_doc_length));
                 double bm25_score = idf * (numerator / denominator);
 
-                double pgscore = pagerank_scores[p.doc_id];
+                double pgscore = (topic >= 0) ? topic_scores.score(topic, p.doc_id) : pagerank_scores.score(p.doc_id);
                 double pgnorm = log(1.0 + pgscore * pagerank_scores.size());
                 doc_scores[p.doc_id] += bm25_score + alpha * pgnorm;
             }
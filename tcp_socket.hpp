@@ -0,0 +1,250 @@
+#ifndef TCP_SOCKET_HPP
+#define TCP_SOCKET_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #ifdef _MSC_VER
+        #pragma comment(lib, "ws2_32.lib")
+    #endif
+#else
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+// Blocking IPv4 TCP stream. MinGW builds link with -lws2_32.
+class TcpSocket {
+public:
+    TcpSocket() = default;
+    TcpSocket(const TcpSocket&) = delete;
+    TcpSocket& operator=(const TcpSocket&) = delete;
+    TcpSocket(TcpSocket&& other) noexcept : handle(other.handle) { other.handle = INVALID; }
+    TcpSocket& operator=(TcpSocket&& other) noexcept {
+        if (this != &other) {
+            close();
+            handle = other.handle;
+            other.handle = INVALID;
+        }
+        return *this;
+    }
+    ~TcpSocket() { close(); }
+
+    // Starts Winsock once per process; a no-op elsewhere.
+    static bool startup() {
+        #ifdef _WIN32
+            static const bool started = [] {
+                WSADATA data;
+                return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+            return started;
+        #else
+            return true;
+        #endif
+    }
+
+    bool listen(const string& host, uint16_t port, string& error) {
+        close();
+        sockaddr_in address;
+        if (!resolve(host, port, address, error)) return false;
+        handle = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (handle == INVALID) {
+            error = "could not create socket";
+            return false;
+        }
+        int yes = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+        if (::bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            error = "could not bind " + host + ":" + to_string(port);
+            close();
+            return false;
+        }
+        if (::listen(handle, SOMAXCONN) != 0) {
+            error = "could not listen on " + host + ":" + to_string(port);
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // Waits for the next connection; the result is closed if accepting failed.
+    TcpSocket accept() {
+        TcpSocket client;
+        client.handle = ::accept(handle, nullptr, nullptr);
+        if (client.isOpen()) client.noDelay();
+        return client;
+    }
+
+    bool connect(const string& host, uint16_t port, string& error) {
+        close();
+        sockaddr_in address;
+        if (!resolve(host, port, address, error)) return false;
+        handle = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (handle == INVALID) {
+            error = "could not create socket";
+            return false;
+        }
+        if (::connect(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            error = "could not connect to " + host + ":" + to_string(port);
+            close();
+            return false;
+        }
+        noDelay();
+        return true;
+    }
+
+    bool sendAll(const char* data, size_t size) {
+        while (size > 0) {
+            int chunk = static_cast<int>(min<size_t>(size, 1 << 30));
+            auto sent = ::send(handle, data, chunk, SEND_FLAGS);
+            if (sent <= 0) return false;
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    // Reads whatever has arrived, at most size bytes; 0 once the peer closed
+    // or the connection failed.
+    size_t receive(char* data, size_t size) {
+        auto got = ::recv(handle, data, static_cast<int>(min<size_t>(size, 1 << 30)), 0);
+        return got > 0 ? static_cast<size_t>(got) : 0;
+    }
+
+    // Sends that cannot make progress for ms milliseconds fail instead of
+    // blocking for good.
+    void sendTimeout(int ms) {
+        #ifdef _WIN32
+            DWORD timeout = ms;
+        #else
+            timeval timeout = {ms / 1000, (ms % 1000) * 1000};
+        #endif
+        setsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+
+    // Ends the connection both ways without closing the handle: receive and
+    // send calls blocked on other threads return at once and fail.
+    void shutdown() {
+        if (handle == INVALID) return;
+        #ifdef _WIN32
+            ::shutdown(handle, SD_BOTH);
+        #else
+            ::shutdown(handle, SHUT_RDWR);
+        #endif
+    }
+
+    void close() {
+        if (handle == INVALID) return;
+        #ifdef _WIN32
+            closesocket(handle);
+        #else
+            ::close(handle);
+        #endif
+        handle = INVALID;
+    }
+
+    bool isOpen() const { return handle != INVALID; }
+
+private:
+    #ifdef _WIN32
+        using Handle = SOCKET;
+        static constexpr Handle INVALID = INVALID_SOCKET;
+        static constexpr int SEND_FLAGS = 0;
+    #else
+        using Handle = int;
+        static constexpr Handle INVALID = -1;
+        #ifdef MSG_NOSIGNAL
+            static constexpr int SEND_FLAGS = MSG_NOSIGNAL;     // a vanished peer is an error, not SIGPIPE
+        #else
+            static constexpr int SEND_FLAGS = 0;
+        #endif
+    #endif
+    Handle handle = INVALID;
+
+    // Small request/reply frames go out at once instead of waiting for Nagle.
+    void noDelay() {
+        int yes = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&yes), sizeof(yes));
+    }
+
+    static bool resolve(const string& host, uint16_t port, sockaddr_in& address, string& error) {
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+            error = "not an IPv4 address: " + host;
+            return false;
+        }
+        return true;
+    }
+};
+
+// Length-prefixed framing: a little-endian uint32 payload size, then the
+// payload. Frames larger than MAX_FRAME_BYTES are refused.
+const uint32_t MAX_FRAME_BYTES = 1 << 20;
+
+inline void appendFrame(string& out, const string& payload) {
+    uint32_t size = payload.size();
+    out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    out += payload;
+}
+
+// Splits a byte stream into frames. Reads are as large as the socket
+// allows, so frames a client sent back to back are usually all buffered
+// after one call; pending() tells whether another frame is ready without
+// blocking.
+class FrameReader {
+public:
+    explicit FrameReader(TcpSocket& socket) : socket(socket) {}
+
+    // The next frame, blocking until it is complete. False at end of
+    // stream or on an oversized frame.
+    bool next(string& payload) {
+        while (!pending()) {
+            if (failed) return false;
+            if (start > 0) {
+                buffer.erase(0, start);
+                start = 0;
+            }
+            size_t used = buffer.size();
+            buffer.resize(used + 65536);
+            size_t got = socket.receive(&buffer[used], 65536);
+            buffer.resize(used + got);
+            if (got == 0) return false;
+        }
+        uint32_t size;
+        memcpy(&size, buffer.data() + start, sizeof(size));
+        payload.assign(buffer, start + sizeof(size), size);
+        start += sizeof(size) + size;
+        return true;
+    }
+
+    // Whether a whole frame is already buffered.
+    bool pending() {
+        if (buffer.size() - start < sizeof(uint32_t)) return false;
+        uint32_t size;
+        memcpy(&size, buffer.data() + start, sizeof(size));
+        if (size > MAX_FRAME_BYTES) {
+            failed = true;
+            return false;
+        }
+        return buffer.size() - start - sizeof(size) >= size;
+    }
+
+private:
+    TcpSocket& socket;
+    string buffer;
+    size_t start = 0;
+    bool failed = false;
+};
+
+#endif // TCP_SOCKET_HPP
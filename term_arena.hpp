@@ -0,0 +1,196 @@
+#ifndef TERM_ARENA_HPP
+#define TERM_ARENA_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Bump allocator over large slabs. Individual allocations are never freed;
+// the whole arena is released at once with reset().
+class Arena {
+public:
+    explicit Arena(size_t slabSize = 64 * 1024 * 1024) : slabSize(slabSize) {}
+
+    void* allocate(size_t bytes, size_t align = alignof(max_align_t)) {
+        size_t pad = (align - (reinterpret_cast<uintptr_t>(cursor) & (align - 1))) & (align - 1);
+        if (pad + bytes > remaining) {
+            size_t size = max(slabSize, bytes + align);
+            slabs.emplace_back(new char[size]);
+            cursor = slabs.back().get();
+            remaining = size;
+            reserved += size;
+            pad = (align - (reinterpret_cast<uintptr_t>(cursor) & (align - 1))) & (align - 1);
+        }
+        char* out = cursor + pad;
+        cursor += pad + bytes;
+        remaining -= pad + bytes;
+        return out;
+    }
+
+    size_t bytesReserved() const { return reserved; }
+
+    void reset() {
+        slabs.clear();
+        slabs.shrink_to_fit();
+        cursor = nullptr;
+        remaining = 0;
+        reserved = 0;
+    }
+
+private:
+    size_t slabSize;
+    vector<unique_ptr<char[]>> slabs;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    size_t reserved = 0;
+};
+
+// Maps term strings to dense ids 0..n-1. Term bytes live in the arena behind a
+// 4 byte length, so an id costs one pointer plus its lookup slot. The lookup
+// table is open addressing with linear probing over the ids.
+class TermInterner {
+public:
+    explicit TermInterner(Arena& arena) : arena(arena) { table.assign(1024, 0); }
+
+    uint32_t intern(string_view term) {
+        if ((entries.size() + 1) * 4 > table.size() * 3) grow();
+
+        size_t mask = table.size() - 1;
+        size_t slot = hash(term) & mask;
+        while (table[slot] != 0) {
+            uint32_t id = table[slot] - 1;
+            if (this->term(id) == term) return id;
+            slot = (slot + 1) & mask;
+        }
+
+        uint32_t len = static_cast<uint32_t>(term.size());
+        char* data = static_cast<char*>(arena.allocate(sizeof(len) + len, alignof(uint32_t)));
+        memcpy(data, &len, sizeof(len));
+        memcpy(data + sizeof(len), term.data(), len);
+        entries.push_back(data);
+        table[slot] = static_cast<uint32_t>(entries.size());
+        return static_cast<uint32_t>(entries.size() - 1);
+    }
+
+    string_view term(uint32_t id) const {
+        uint32_t len;
+        memcpy(&len, entries[id], sizeof(len));
+        return string_view(entries[id] + sizeof(len), len);
+    }
+
+    size_t size() const { return entries.size(); }
+
+    size_t bytesUsed() const {
+        return table.capacity() * sizeof(uint32_t) + entries.capacity() * sizeof(const char*);
+    }
+
+    void clear() {
+        vector<const char*>().swap(entries);
+        table.assign(1024, 0);
+        table.shrink_to_fit();
+    }
+
+private:
+    Arena& arena;
+    vector<const char*> entries;
+    vector<uint32_t> table;
+
+    static uint64_t hash(string_view s) {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    void grow() {
+        vector<uint32_t> bigger(table.size() * 2, 0);
+        size_t mask = bigger.size() - 1;
+        for (uint32_t id = 0; id < entries.size(); id++) {
+            size_t slot = hash(term(id)) & mask;
+            while (bigger[slot] != 0) slot = (slot + 1) & mask;
+            bigger[slot] = id + 1;
+        }
+        table.swap(bigger);
+    }
+};
+
+// Per-term posting lists stored as linked chunks carved out of the arena.
+// Chunks double in size up to MAX_CHUNK so rare terms stay small and common
+// terms do not pay for a long chain. Only the tail is kept per term; the
+// chain is circular (tail->next is the head) until it is read.
+template <typename T>
+class PostingChains {
+public:
+    struct Chunk {
+        Chunk* next;
+        uint32_t count;
+        uint32_t capacity;
+
+        T* data() { return reinterpret_cast<T*>(this + 1); }
+        const T* data() const { return reinterpret_cast<const T*>(this + 1); }
+    };
+
+    static constexpr uint32_t FIRST_CHUNK = 2;
+    static constexpr uint32_t MAX_CHUNK = 4096;
+
+    explicit PostingChains(Arena& arena) : arena(arena) {}
+
+    void append(uint32_t termId, const T& posting) {
+        if (termId >= lists.size()) lists.resize(termId + 1);
+        List& list = lists[termId];
+
+        if (list.tail == nullptr || list.tail->count == list.tail->capacity) {
+            uint32_t capacity = list.tail ? min(list.tail->capacity * 2, MAX_CHUNK) : FIRST_CHUNK;
+            Chunk* chunk = static_cast<Chunk*>(arena.allocate(sizeof(Chunk) + capacity * sizeof(T), alignof(Chunk)));
+            chunk->count = 0;
+            chunk->capacity = capacity;
+            if (list.tail) {
+                chunk->next = list.tail->next;
+                list.tail->next = chunk;
+            } else {
+                chunk->next = chunk;
+            }
+            list.tail = chunk;
+        }
+
+        list.tail->data()[list.tail->count++] = posting;
+        list.size++;
+    }
+
+    uint32_t size(uint32_t termId) const { return lists[termId].size; }
+
+    // Visits the chunks of a term in insertion order.
+    template <typename F>
+    void forEachChunk(uint32_t termId, F&& visit) const {
+        const Chunk* tail = lists[termId].tail;
+        if (tail == nullptr) return;
+        const Chunk* chunk = tail->next;
+        while (true) {
+            visit(chunk->data(), chunk->count);
+            if (chunk == tail) break;
+            chunk = chunk->next;
+        }
+    }
+
+    size_t bytesUsed() const { return lists.capacity() * sizeof(List); }
+
+    void clear() { vector<List>().swap(lists); }
+
+private:
+    struct List {
+        Chunk* tail = nullptr;
+        uint32_t size = 0;
+    };
+
+    Arena& arena;
+    vector<List> lists;
+};
+
+#endif // TERM_ARENA_HPP
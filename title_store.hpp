@@ -0,0 +1,267 @@
+#ifndef TITLE_STORE_HPP
+#define TITLE_STORE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "index_format.hpp"
+#include "mmap_file.hpp"
+
+using namespace std;
+
+// Page titles and document lengths from doc_info.jsonl, written once by the
+// autocomplete build and memory-mapped by autocomplete and search, so every
+// title is held once in the page cache instead of once per process.
+//
+//   TitleStoreHeader
+//   uint64 block_offsets[numBlocks + 1]  block b is blocks[block_offsets[b] .. block_offsets[b+1])
+//   uint8  blocks[...]                   TITLE_BLOCK_SIZE titles per block, front-coded: the
+//                                        first as varint length + bytes, the others as varint
+//                                        shared prefix, varint suffix length + suffix bytes
+//   int32  ids[numIds]                   ascending page ids
+//   uint32 id_rows[numIds]               row of the title of ids[i]
+//   uint32 id_lengths[numIds]            document length of ids[i]
+//   uint32 id_buckets[numBuckets + 1]    entries whose id >> bucketShift == b are
+//                                        id_buckets[b] .. id_buckets[b+1]
+//
+// Rows are numbered in the order the writer received them. The autocomplete
+// build adds them sorted by lowercased title, which is what makes neighbours
+// share prefixes. Every section starts on a 64-byte boundary; the checksum is
+// FNV-1a over the header bytes before it.
+
+const char TITLE_MAGIC[8] = {'W', 'K', 'T', 'I', 'T', 'L', 'E', '\0'};
+const uint32_t TITLE_VERSION = 1;
+const uint32_t TITLE_BLOCK_SIZE = 16;
+
+struct TitleStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t blockSize;
+    uint32_t bucketShift;
+    uint64_t numTitles;
+    uint64_t numIds;
+    uint64_t numBlocks;
+    uint64_t numBuckets;
+    uint64_t blockOffsetsPos;
+    uint64_t blocksPos;
+    uint64_t idsPos;
+    uint64_t idRowsPos;
+    uint64_t idLengthsPos;
+    uint64_t bucketsPos;
+    uint64_t checksum;
+};
+
+inline uint64_t title_align(uint64_t pos) {
+    return (pos + 63) & ~uint64_t(63);
+}
+
+class TitleStoreWriter {
+public:
+    // Appends the next row.
+    void add(string_view title, int pageId, uint32_t length) {
+        if (numTitles % TITLE_BLOCK_SIZE == 0) {
+            blockOffsets.push_back(blocks.size());
+            write_varint(blocks, title.size());
+            blocks.append(title.data(), title.size());
+        } else {
+            size_t shared = 0;
+            size_t limit = min(previous.size(), title.size());
+            while (shared < limit && previous[shared] == title[shared]) shared++;
+            write_varint(blocks, shared);
+            write_varint(blocks, title.size() - shared);
+            blocks.append(title.data() + shared, title.size() - shared);
+        }
+        previous.assign(title.data(), title.size());
+        entries.push_back({pageId, static_cast<uint32_t>(numTitles), length});
+        numTitles++;
+    }
+
+    uint64_t size() const { return numTitles; }
+
+    // checksum receives the header checksum, which readers of files built
+    // against this store can compare with TitleStore::checksum().
+    bool write(const string& path, uint64_t& checksum) {
+        sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.pageId < b.pageId; });
+        vector<uint64_t> offsets = blockOffsets;
+        offsets.push_back(blocks.size());
+
+        TitleStoreHeader header = {};
+        memcpy(header.magic, TITLE_MAGIC, sizeof(TITLE_MAGIC));
+        header.version = TITLE_VERSION;
+        header.headerSize = sizeof(TitleStoreHeader);
+        header.blockSize = TITLE_BLOCK_SIZE;
+        header.numTitles = numTitles;
+        header.numBlocks = blockOffsets.size();
+
+        // About four pages per bucket, as in score_file.hpp.
+        int64_t maxId = entries.empty() ? 0 : max(0, entries.back().pageId);
+        uint64_t wanted = max<uint64_t>(1, numTitles / 4);
+        while (static_cast<uint64_t>(maxId >> header.bucketShift) + 1 > wanted) header.bucketShift++;
+        header.numBuckets = static_cast<uint64_t>(maxId >> header.bucketShift) + 1;
+
+        // Rows with a negative page id keep their title but cannot be looked up by id.
+        vector<int32_t> ids;
+        vector<uint32_t> rows, lengths;
+        vector<uint32_t> buckets(header.numBuckets + 1, 0);
+        for (const Entry& e : entries) {
+            if (e.pageId < 0) continue;
+            ids.push_back(e.pageId);
+            rows.push_back(e.row);
+            lengths.push_back(e.length);
+            buckets[(e.pageId >> header.bucketShift) + 1]++;
+        }
+        for (uint64_t b = 0; b < header.numBuckets; b++) buckets[b + 1] += buckets[b];
+        header.numIds = ids.size();
+
+        header.blockOffsetsPos = title_align(sizeof(TitleStoreHeader));
+        header.blocksPos = title_align(header.blockOffsetsPos + offsets.size() * sizeof(uint64_t));
+        header.idsPos = title_align(header.blocksPos + blocks.size());
+        header.idRowsPos = title_align(header.idsPos + ids.size() * sizeof(int32_t));
+        header.idLengthsPos = title_align(header.idRowsPos + rows.size() * sizeof(uint32_t));
+        header.bucketsPos = title_align(header.idLengthsPos + lengths.size() * sizeof(uint32_t));
+        header.checksum = fnv1a(&header, offsetof(TitleStoreHeader, checksum));
+        checksum = header.checksum;
+
+        ofstream out(path, ios::binary);
+        if (!out.is_open()) return false;
+        auto writeAt = [&out](uint64_t at, const void* bytes, uint64_t len) {
+            static const char zeros[64] = {};
+            out.write(zeros, at - static_cast<uint64_t>(out.tellp()));
+            out.write(static_cast<const char*>(bytes), len);
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeAt(header.blockOffsetsPos, offsets.data(), offsets.size() * sizeof(uint64_t));
+        writeAt(header.blocksPos, blocks.data(), blocks.size());
+        writeAt(header.idsPos, ids.data(), ids.size() * sizeof(int32_t));
+        writeAt(header.idRowsPos, rows.data(), rows.size() * sizeof(uint32_t));
+        writeAt(header.idLengthsPos, lengths.data(), lengths.size() * sizeof(uint32_t));
+        writeAt(header.bucketsPos, buckets.data(), buckets.size() * sizeof(uint32_t));
+        out.close();
+        return !out.fail();
+    }
+
+private:
+    struct Entry {
+        int pageId;
+        uint32_t row;
+        uint32_t length;
+    };
+
+    string blocks;
+    string previous;
+    vector<uint64_t> blockOffsets;
+    vector<Entry> entries;
+    uint64_t numTitles = 0;
+};
+
+// Read-only view of a mapped titles.bin.
+class TitleStore {
+public:
+    bool open(const string& path, string& error) {
+        if (!file.open(path)) {
+            error = "could not map " + path;
+            return false;
+        }
+        if (file.size() < sizeof(TitleStoreHeader)) {
+            error = "file too short for header";
+            return fail();
+        }
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, TITLE_MAGIC, sizeof(TITLE_MAGIC)) != 0) {
+            error = "bad magic, not a title store";
+            return fail();
+        }
+        if (header.version != TITLE_VERSION || header.headerSize != sizeof(TitleStoreHeader) || header.blockSize != TITLE_BLOCK_SIZE) {
+            error = "unsupported title store version " + to_string(header.version);
+            return fail();
+        }
+        if (header.checksum != fnv1a(&header, offsetof(TitleStoreHeader, checksum))) {
+            error = "header checksum mismatch";
+            return fail();
+        }
+        if (header.bucketsPos + (header.numBuckets + 1) * sizeof(uint32_t) > file.size()
+            || header.blockOffsetsPos + (header.numBlocks + 1) * sizeof(uint64_t) > file.size()) {
+            error = "file truncated";
+            return fail();
+        }
+
+        const char* base = file.data();
+        blockOffsets = reinterpret_cast<const uint64_t*>(base + header.blockOffsetsPos);
+        blocks = base + header.blocksPos;
+        ids = reinterpret_cast<const int32_t*>(base + header.idsPos);
+        idRows = reinterpret_cast<const uint32_t*>(base + header.idRowsPos);
+        idLengths = reinterpret_cast<const uint32_t*>(base + header.idLengthsPos);
+        buckets = reinterpret_cast<const uint32_t*>(base + header.bucketsPos);
+        if (header.blocksPos + blockOffsets[header.numBlocks] > file.size()) {
+            error = "title blocks past end of file";
+            return fail();
+        }
+        return true;
+    }
+
+    uint64_t size() const { return header.numTitles; }
+    uint64_t checksum() const { return header.checksum; }
+
+    // Title of a row; decodes at most TITLE_BLOCK_SIZE - 1 entries before it.
+    string title(uint64_t row) const {
+        const char* p = blocks + blockOffsets[row / TITLE_BLOCK_SIZE];
+        uint64_t len = read_varint(p);
+        string text(p, len);
+        p += len;
+        for (uint64_t k = row % TITLE_BLOCK_SIZE; k > 0; k--) {
+            uint64_t shared = read_varint(p);
+            uint64_t suffix = read_varint(p);
+            text.resize(shared);
+            text.append(p, suffix);
+            p += suffix;
+        }
+        return text;
+    }
+
+    // Title of a page; false if the page is not in the store.
+    bool titleOf(int pageId, string& out) const {
+        int64_t i = find(pageId);
+        if (i < 0) return false;
+        out = title(idRows[i]);
+        return true;
+    }
+
+    // Document length of a page, -1 if the page is not in the store.
+    int64_t lengthOf(int pageId) const {
+        int64_t i = find(pageId);
+        return i < 0 ? -1 : idLengths[i];
+    }
+
+private:
+    MappedFile file;
+    TitleStoreHeader header = {};
+    const uint64_t* blockOffsets = nullptr;
+    const char* blocks = nullptr;
+    const int32_t* ids = nullptr;
+    const uint32_t* idRows = nullptr;
+    const uint32_t* idLengths = nullptr;
+    const uint32_t* buckets = nullptr;
+
+    int64_t find(int pageId) const {
+        if (pageId < 0) return -1;
+        uint64_t bucket = static_cast<uint64_t>(pageId) >> header.bucketShift;
+        if (bucket >= header.numBuckets) return -1;
+        const int32_t* first = ids + buckets[bucket];
+        const int32_t* last = ids + buckets[bucket + 1];
+        const int32_t* it = lower_bound(first, last, pageId);
+        return (it != last && *it == pageId) ? it - ids : -1;
+    }
+
+    bool fail() {
+        file.close();
+        return false;
+    }
+};
+
+#endif // TITLE_STORE_HPP